@@ -1,19 +1,40 @@
 // tool.cpp — OOP refactor, encapsulated commands as class methods
 // C++17, portable across Linux/macOS/Windows.
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <cctype>
+#include <climits>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <locale>
+#include <memory>
+#include <mutex>
 #include <random>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 
+#if defined(__SSE2__)
+  #include <emmintrin.h>
+#endif
+#if __has_include(<charconv>)
+  #include <charconv>
+#endif
 #if __has_include(<filesystem>)
   #include <filesystem>
   namespace fs = std::filesystem;
@@ -25,64 +46,2046 @@
   #define GETCWD _getcwd
 #else
   #define OS_WIN 0
+  #include <arpa/inet.h>
+  #include <dirent.h>
+  #include <sys/socket.h>
+  #include <fcntl.h>
+  #include <poll.h>
+  #include <signal.h>
+  #include <spawn.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <sys/wait.h>
   #include <unistd.h>
+  #include <cerrno>
+  #ifdef __linux__
+    #include <sys/random.h>
+    #include <sys/sendfile.h>
+  #endif
   #define GETCWD getcwd
+  extern char** environ;
 #endif
 
 using namespace std;
 
+// -------- Column kernels (SIMD with runtime dispatch) --------
+// One function per binary operator, w[r] = a[r] op b[r]. The scalar set is
+// the reference; on x86 with GCC/Clang the SSE4.1 and AVX2 sets are compiled
+// with per-function target attributes and picked once from CPUID, so the
+// binary still runs on any x86-64. CALC_SIMD=scalar|sse|avx2 overrides it.
+typedef void (*Kernel)(double* w, const double* a, const double* b, size_t n);
+struct Kernels { const char* name; Kernel add, sub, mul, div, pow, mod; };
+
+// % and // truncate both operands to long long. A zero divisor or an operand
+// outside that range (NaN and inf included) gives NaN rather than trapping,
+// so one bad row cannot take down a whole batch.
+static inline bool int_operands(double a, double b) {
+    return fabs(a) < 9.2e18 && fabs(b) < 9.2e18 && static_cast<long long>(b) != 0;
+}
+static inline double mod_scalar(double a, double b) {
+    if (!int_operands(a, b)) return numeric_limits<double>::quiet_NaN();
+    return static_cast<double>(static_cast<long long>(a) % static_cast<long long>(b));
+}
+static inline double idiv_scalar(double a, double b) {
+    if (!int_operands(a, b)) return numeric_limits<double>::quiet_NaN();
+    return static_cast<double>(static_cast<long long>(a) / static_cast<long long>(b));
+}
+
+static void k_add(double* w, const double* a, const double* b, size_t n) { for (size_t r = 0; r < n; ++r) w[r] = a[r] + b[r]; }
+static void k_sub(double* w, const double* a, const double* b, size_t n) { for (size_t r = 0; r < n; ++r) w[r] = a[r] - b[r]; }
+static void k_mul(double* w, const double* a, const double* b, size_t n) { for (size_t r = 0; r < n; ++r) w[r] = a[r] * b[r]; }
+static void k_div(double* w, const double* a, const double* b, size_t n) { for (size_t r = 0; r < n; ++r) w[r] = a[r] / b[r]; }
+static void k_pow(double* w, const double* a, const double* b, size_t n) { for (size_t r = 0; r < n; ++r) w[r] = pow(a[r], b[r]); }
+static void k_mod(double* w, const double* a, const double* b, size_t n) { for (size_t r = 0; r < n; ++r) w[r] = mod_scalar(a[r], b[r]); }
+
+static const Kernels SCALAR_KERNELS = { "scalar", k_add, k_sub, k_mul, k_div, k_pow, k_mod };
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #define CALC_X86_SIMD 1
+  #include <immintrin.h>
+
+// Both SIMD tiers are generated from one body: V is the vector type, L the
+// lane count and the macros map to the matching intrinsics.
+//  - pow: lanes whose exponent is an integer with |e| <= 64 use binary
+//    exponentiation (a few ulp from std::pow, far cheaper); any other lane
+//    group falls back to std::pow.
+//  - %: with |a|,|b| < 2^52 and b != 0, trunc(a) - trunc(trunc(a)/trunc(b))*trunc(b)
+//    is exactly the long long remainder; other lane groups go scalar.
+#define CALC_SIMD_KERNELS(TGT, SUF, V, L, LOAD, STORE, SET1, ADD, SUB, MUL, DIV, TRUNC, ABS, LT, EQ, AND, ANDN, OR, BLEND, MASK, ALL) \
+__attribute__((target(TGT))) static void k_add_##SUF(double* w, const double* a, const double* b, size_t n) { \
+    size_t r = 0; for (; r + L <= n; r += L) STORE(w + r, ADD(LOAD(a + r), LOAD(b + r))); for (; r < n; ++r) w[r] = a[r] + b[r]; } \
+__attribute__((target(TGT))) static void k_sub_##SUF(double* w, const double* a, const double* b, size_t n) { \
+    size_t r = 0; for (; r + L <= n; r += L) STORE(w + r, SUB(LOAD(a + r), LOAD(b + r))); for (; r < n; ++r) w[r] = a[r] - b[r]; } \
+__attribute__((target(TGT))) static void k_mul_##SUF(double* w, const double* a, const double* b, size_t n) { \
+    size_t r = 0; for (; r + L <= n; r += L) STORE(w + r, MUL(LOAD(a + r), LOAD(b + r))); for (; r < n; ++r) w[r] = a[r] * b[r]; } \
+__attribute__((target(TGT))) static void k_div_##SUF(double* w, const double* a, const double* b, size_t n) { \
+    size_t r = 0; for (; r + L <= n; r += L) STORE(w + r, DIV(LOAD(a + r), LOAD(b + r))); for (; r < n; ++r) w[r] = a[r] / b[r]; } \
+__attribute__((target(TGT))) static void k_pow_##SUF(double* w, const double* a, const double* b, size_t n) { \
+    const V one = SET1(1.0), lim = SET1(64.0), half = SET1(0.5); \
+    size_t r = 0; \
+    for (; r + L <= n; r += L) { \
+        V x = LOAD(a + r), e = LOAD(b + r); \
+        V ae = ABS(e); \
+        if (MASK(AND(EQ(TRUNC(e), e), OR(LT(ae, lim), EQ(ae, lim)))) != ALL) { for (size_t k = r; k < r + L; ++k) w[k] = pow(a[k], b[k]); continue; } \
+        V acc = one, base = x; \
+        while (MASK(LT(half, ae))) { \
+            V odd = LT(half, SUB(ae, MUL(SET1(2.0), TRUNC(MUL(ae, half))))); \
+            acc = BLEND(acc, MUL(acc, base), odd); \
+            base = MUL(base, base); \
+            ae = TRUNC(MUL(ae, half)); \
+        } \
+        STORE(w + r, BLEND(acc, DIV(one, acc), LT(e, SET1(0.0)))); \
+    } \
+    for (; r < n; ++r) w[r] = pow(a[r], b[r]); } \
+__attribute__((target(TGT))) static void k_mod_##SUF(double* w, const double* a, const double* b, size_t n) { \
+    const V lim = SET1(4503599627370496.0), zero = SET1(0.0); \
+    size_t r = 0; \
+    for (; r + L <= n; r += L) { \
+        V ta = TRUNC(LOAD(a + r)), tb = TRUNC(LOAD(b + r)); \
+        V ok = AND(LT(ABS(ta), lim), ANDN(EQ(tb, zero), LT(ABS(tb), lim))); \
+        if (MASK(ok) != ALL) { for (size_t k = r; k < r + L; ++k) w[k] = mod_scalar(a[k], b[k]); continue; } \
+        STORE(w + r, SUB(ta, MUL(TRUNC(DIV(ta, tb)), tb))); \
+    } \
+    for (; r < n; ++r) w[r] = mod_scalar(a[r], b[r]); }
+
+#define SSE_ABS(x)  _mm_andnot_pd(_mm_set1_pd(-0.0), (x))
+#define SSE_TRUNC(x) _mm_round_pd((x), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC)
+#define SSE_BLEND(a, b, m) _mm_blendv_pd((a), (b), (m))
+CALC_SIMD_KERNELS("sse4.1", sse, __m128d, 2, _mm_loadu_pd, _mm_storeu_pd, _mm_set1_pd, _mm_add_pd, _mm_sub_pd, _mm_mul_pd, _mm_div_pd,
+                  SSE_TRUNC, SSE_ABS, _mm_cmplt_pd, _mm_cmpeq_pd, _mm_and_pd, _mm_andnot_pd, _mm_or_pd, SSE_BLEND, _mm_movemask_pd, 0x3)
+
+#define AVX_ABS(x)  _mm256_andnot_pd(_mm256_set1_pd(-0.0), (x))
+#define AVX_TRUNC(x) _mm256_round_pd((x), _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC)
+#define AVX_LT(a, b) _mm256_cmp_pd((a), (b), _CMP_LT_OQ)
+#define AVX_EQ(a, b) _mm256_cmp_pd((a), (b), _CMP_EQ_OQ)
+#define AVX_BLEND(a, b, m) _mm256_blendv_pd((a), (b), (m))
+CALC_SIMD_KERNELS("avx2", avx2, __m256d, 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_set1_pd, _mm256_add_pd, _mm256_sub_pd, _mm256_mul_pd, _mm256_div_pd,
+                  AVX_TRUNC, AVX_ABS, AVX_LT, AVX_EQ, _mm256_and_pd, _mm256_andnot_pd, _mm256_or_pd, AVX_BLEND, _mm256_movemask_pd, 0xF)
+
+static const Kernels SSE_KERNELS  = { "sse4.1", k_add_sse,  k_sub_sse,  k_mul_sse,  k_div_sse,  k_pow_sse,  k_mod_sse };
+static const Kernels AVX2_KERNELS = { "avx2",   k_add_avx2, k_sub_avx2, k_mul_avx2, k_div_avx2, k_pow_avx2, k_mod_avx2 };
+#endif
+
+static const Kernels& kernels() {
+    static const Kernels* k = [] {
+        const char* want = getenv("CALC_SIMD");
+        string w = want ? want : "";
+        if (w == "scalar") return &SCALAR_KERNELS;
+#ifdef CALC_X86_SIMD
+        __builtin_cpu_init();
+        if (w != "sse" && __builtin_cpu_supports("avx2")) return &AVX2_KERNELS;
+        if (__builtin_cpu_supports("sse4.1")) return &SSE_KERNELS;
+#endif
+        return &SCALAR_KERNELS;
+    }();
+    return *k;
+}
+
+// -------- Compiled expression (flat stack-machine bytecode) --------
+enum class Op : unsigned char { Push, Load, Dup, Neg, Add, Sub, Mul, Div, Mod, Pow, IDiv };
+struct Instr { Op op; unsigned var; double k; };
+
+class Program {
+public:
+    // vars[n] is the value bound to variables()[n].
+    double evaluate(const double* vars = nullptr) const;
+    // Structure-of-arrays batch: cols[n] is the column for variables()[n];
+    // all columns must have the same length, out is resized to match (a
+    // formula without variables just fills out at its current size).
+    void evaluate_batch(const vector<const vector<double>*>& cols, vector<double>& out) const;
+    void evaluate_batch(const unordered_map<string, vector<double>>& cols, vector<double>& out) const;
+    const vector<string>& variables() const { return vars; }
+    size_t size() const { return code.size(); }
+    void optimize();
+private:
+    friend class Parser;
+    static constexpr size_t BLOCK = 256;
+    vector<Instr> code;
+    vector<string> vars;
+    size_t depth{0}, height{0};
+    void emit(Op op, double k = 0.0, unsigned var = 0) {
+        code.push_back({op, var, k});
+        if (op == Op::Push || op == Op::Load || op == Op::Dup) depth = max(depth, ++height);
+        else if (op != Op::Neg) --height;
+    }
+    unsigned var_index(const string& name) {
+        for (size_t n = 0; n < vars.size(); ++n) if (vars[n] == name) return static_cast<unsigned>(n);
+        vars.push_back(name);
+        return static_cast<unsigned>(vars.size() - 1);
+    }
+    void run_block(const double* const* cols, size_t row, size_t len, double* scratch, double* dst) const;
+    size_t rewrite(int pass);
+};
+
+double Program::evaluate(const double* vals) const {
+    if (!vals && !vars.empty()) throw runtime_error("unbound variable '" + vars[0] + "'");
+    double small[32];
+    vector<double> big;
+    double* st = small;
+    if (depth > 32) { big.resize(depth); st = big.data(); }
+    size_t sp = 0;
+    for (const Instr& in : code) {
+        switch (in.op) {
+        case Op::Push: st[sp++] = in.k; break;
+        case Op::Load: st[sp++] = vals[in.var]; break;
+        case Op::Dup:  st[sp] = st[sp - 1]; ++sp; break;
+        case Op::Neg:  st[sp - 1] = -st[sp - 1]; break;
+        case Op::Add:  --sp; st[sp - 1] += st[sp]; break;
+        case Op::Sub:  --sp; st[sp - 1] -= st[sp]; break;
+        case Op::Mul:  --sp; st[sp - 1] *= st[sp]; break;
+        case Op::Div:  --sp; st[sp - 1] /= st[sp]; break;
+        case Op::Pow:  --sp; st[sp - 1] = pow(st[sp - 1], st[sp]); break;
+        case Op::Mod:  --sp; st[sp - 1] = mod_scalar(st[sp - 1], st[sp]); break;
+        case Op::IDiv: --sp; st[sp - 1] = idiv_scalar(st[sp - 1], st[sp]); break;
+        }
+    }
+    return sp ? st[0] : 0.0;
+}
+
+// Runs the bytecode once per block of rows rather than once per row: every
+// binary instruction becomes one call into the selected column kernel. Stack
+// slot n owns scratch[n*BLOCK ...]; Load just points at the input column so
+// columns are never copied.
+void Program::run_block(const double* const* cols, size_t row, size_t len, double* scratch, double* dst) const {
+    const Kernels& k = kernels();
+    const double* slot[64];
+    vector<const double*> big;
+    const double** st = slot;
+    if (depth > 64) { big.resize(depth); st = big.data(); }
+    size_t sp = 0;
+    for (const Instr& in : code) {
+        double* w = sp ? scratch + (sp - 1) * BLOCK : nullptr;
+        switch (in.op) {
+        case Op::Push: {
+            double* p = scratch + sp * BLOCK;
+            for (size_t r = 0; r < len; ++r) p[r] = in.k;
+            st[sp++] = p; break;
+        }
+        case Op::Load: st[sp++] = cols[in.var] + row; break;
+        case Op::Dup:  st[sp] = st[sp - 1]; ++sp; break;
+        case Op::Neg: { const double* a = st[sp - 1]; for (size_t r = 0; r < len; ++r) w[r] = -a[r]; st[sp - 1] = w; break; }
+        default: {
+            --sp; w = scratch + (sp - 1) * BLOCK;
+            const double* a = st[sp - 1];
+            const double* b = st[sp];
+            switch (in.op) {
+            case Op::Add: k.add(w, a, b, len); break;
+            case Op::Sub: k.sub(w, a, b, len); break;
+            case Op::Mul: k.mul(w, a, b, len); break;
+            case Op::Div: k.div(w, a, b, len); break;
+            case Op::Pow: k.pow(w, a, b, len); break;
+            case Op::Mod: k.mod(w, a, b, len); break;
+            case Op::IDiv: for (size_t r = 0; r < len; ++r) w[r] = idiv_scalar(a[r], b[r]); break;
+            default: break;
+            }
+            st[sp - 1] = w;
+        }
+        }
+    }
+    if (sp) copy(st[0], st[0] + len, dst);
+    else fill(dst, dst + len, 0.0);
+}
+
+void Program::evaluate_batch(const vector<const vector<double>*>& cols, vector<double>& out) const {
+    if (cols.size() < vars.size()) throw runtime_error("unbound variable '" + vars[cols.size()] + "'");
+    size_t rows = vars.empty() ? out.size() : cols[0]->size();
+    vector<const double*> base(vars.size());
+    for (size_t n = 0; n < vars.size(); ++n) {
+        if (cols[n]->size() != rows) throw runtime_error("column '" + vars[n] + "' has a different length");
+        base[n] = cols[n]->data();
+    }
+    out.resize(rows);
+    vector<double> scratch(max<size_t>(depth, 1) * BLOCK);
+    for (size_t row = 0; row < rows; row += BLOCK)
+        run_block(base.data(), row, min(BLOCK, rows - row), scratch.data(), out.data() + row);
+}
+
+void Program::evaluate_batch(const unordered_map<string, vector<double>>& cols, vector<double>& out) const {
+    vector<const vector<double>*> bound;
+    for (const string& name : vars) {
+        auto it = cols.find(name);
+        if (it == cols.end()) throw runtime_error("unbound variable '" + name + "'");
+        bound.push_back(&it->second);
+    }
+    evaluate_batch(bound, out);
+}
+
+// -------- Optimizer --------
+// Rewrites the bytecode before it is cached, tracking for every stack value
+// the first instruction that produced it (so an operand's span can be cut out)
+// and whether it is a known constant:
+//  - fold:     constant operands are evaluated now (never % or // by zero);
+//  - identity: x+0, 0+x, x-0, x*1, 1*x, x/1, x^1, -(-x) are dropped and x^0 becomes 1;
+//  - strength: x^2 becomes x*x via Dup, so the operand is computed once.
+// fold and identity repeat until neither changes anything. With CALC_DEBUG
+// set, each pass reports how many instructions it removed.
+static bool fold_binary(Op op, double a, double b, double& r) {
+    auto int_ok = [](double v) { return fabs(v) < 9.2e18; };
+    switch (op) {
+    case Op::Add: r = a + b; return true;
+    case Op::Sub: r = a - b; return true;
+    case Op::Mul: r = a * b; return true;
+    case Op::Div: r = a / b; return true;
+    case Op::Pow: r = pow(a, b); return true;
+    case Op::Mod:
+    case Op::IDiv: {
+        if (!int_ok(a) || !int_ok(b)) return false;
+        long long x = static_cast<long long>(a), y = static_cast<long long>(b);
+        if (y == 0 || (y == -1 && x == LLONG_MIN)) return false;
+        r = static_cast<double>(op == Op::Mod ? x % y : x / y);
+        return true;
+    }
+    default: return false;
+    }
+}
+
+size_t Program::rewrite(int pass) {
+    struct Val { size_t start; bool is_const; double k; };
+    vector<Instr> out;
+    vector<Val> st;
+    out.reserve(code.size());
+    for (const Instr& in : code) {
+        if (in.op == Op::Push || in.op == Op::Load) {
+            st.push_back({out.size(), in.op == Op::Push, in.k});
+            out.push_back(in);
+            continue;
+        }
+        if (in.op == Op::Dup) {
+            st.push_back({out.size(), st.back().is_const, st.back().k});
+            out.push_back(in);
+            continue;
+        }
+        if (in.op == Op::Neg) {
+            Val& v = st.back();
+            if (pass == 0 && v.is_const && out.back().op == Op::Push) { v.k = -v.k; out.back().k = v.k; continue; }
+            if (pass == 1 && out.back().op == Op::Neg && out.size() - 1 > v.start) { out.pop_back(); continue; }
+            out.push_back(in);
+            continue;
+        }
+        Val b = st.back(); st.pop_back();
+        Val a = st.back(); st.pop_back();
+        bool b_single = out.size() - b.start == 1, a_single = b.start - a.start == 1;
+        double r = 0.0;
+        if (pass == 0 && a.is_const && b.is_const && a_single && b_single && fold_binary(in.op, a.k, b.k, r)) {
+            out.resize(a.start);
+            out.push_back({Op::Push, 0, r});
+            st.push_back({a.start, true, r});
+            continue;
+        }
+        if (pass == 1 && b.is_const && b_single) {
+            bool zero = b.k == 0.0, one = b.k == 1.0;
+            if (((in.op == Op::Add || in.op == Op::Sub) && zero) || ((in.op == Op::Mul || in.op == Op::Div || in.op == Op::Pow) && one)) {
+                out.pop_back();
+                st.push_back(a);
+                continue;
+            }
+            if (in.op == Op::Pow && zero) {
+                out.resize(a.start);
+                out.push_back({Op::Push, 0, 1.0});
+                st.push_back({a.start, true, 1.0});
+                continue;
+            }
+        }
+        if (pass == 1 && a.is_const && a_single && ((in.op == Op::Add && a.k == 0.0) || (in.op == Op::Mul && a.k == 1.0))) {
+            out.erase(out.begin() + static_cast<ptrdiff_t>(a.start));
+            st.push_back({a.start, b.is_const, b.k});
+            continue;
+        }
+        if (pass == 2 && in.op == Op::Pow && b.is_const && b_single && b.k == 2.0) {
+            out.back() = {Op::Dup, 0, 0.0};
+            out.push_back({Op::Mul, 0, 0.0});
+            st.push_back({a.start, false, 0.0});
+            continue;
+        }
+        out.push_back(in);
+        st.push_back({a.start, false, 0.0});
+    }
+    size_t removed = code.size() - out.size();
+    code.swap(out);
+    return removed;
+}
+
+void Program::optimize() {
+    static const bool debug = getenv("CALC_DEBUG") != nullptr;
+    size_t before = code.size(), folded = 0, identities = 0, strength = 0;
+    for (int round = 0; round < 8; ++round) {
+        size_t f = rewrite(0), id = rewrite(1);
+        folded += f; identities += id;
+        if (!f && !id) break;
+    }
+    for (const Instr& in : code) if (in.op == Op::Pow) ++strength;
+    rewrite(2);
+    for (const Instr& in : code) if (in.op == Op::Pow) --strength;
+    depth = height = 0;
+    for (const Instr& in : code) {
+        if (in.op == Op::Push || in.op == Op::Load || in.op == Op::Dup) depth = max(depth, ++height);
+        else if (in.op != Op::Neg) --height;
+    }
+    if (debug)
+        cerr << "[calc] optimize: fold removed " << folded << ", identity removed " << identities
+             << ", strength rewrote " << strength << " (" << before << " -> " << code.size() << " instructions)\n";
+}
+
+// -------- Number lexing --------
+// Locale-independent decimal lexer that works straight on the input buffer
+// (no substr, no allocation). Up to 19 significant digits are gathered into
+// an integer; when that mantissa and the power of ten are both exactly
+// representable (<= 2^53 and |exp| <= 22) one multiply or divide gives the
+// correctly rounded result. Anything longer takes the from_chars path.
+static const double POW10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Lexes digits with at most one '.'; returns the end of the literal, or
+// nullptr when [p, end) does not start with one.
+static const char* lex_number(const char* p, const char* end, double& out) {
+    const char* q = p;
+    unsigned long long m = 0;
+    int digits = 0, e10 = 0;
+    bool dot = false, any = false, truncated = false;
+    for (; q < end; ++q) {
+        char c = *q;
+        if (c == '.') { if (dot) break; dot = true; continue; }
+        if (c < '0' || c > '9') break;
+        any = true;
+        if (m == 0 && c == '0') { if (dot) --e10; continue; }
+        if (digits < 19) { m = m * 10 + static_cast<unsigned>(c - '0'); ++digits; if (dot) --e10; }
+        else { truncated = true; if (!dot) ++e10; }
+    }
+    if (!any) return nullptr;
+    if (!truncated && m <= (1ULL << 53) && e10 >= -22 && e10 <= 22) {
+        double v = static_cast<double>(m);
+        out = e10 < 0 ? v / POW10[-e10] : v * POW10[e10];
+        return q;
+    }
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+    if (from_chars(p, q, out, chars_format::fixed).ec != errc()) return nullptr;
+#else
+    istringstream is(string(p, q));
+    is.imbue(locale::classic());
+    if (!(is >> out)) return nullptr;
+#endif
+    return q;
+}
+
 // -------- Parser for calculator --------
+// Recursive descent that emits bytecode into a Program instead of evaluating
+// in place, so an expression can be parsed once and evaluated many times.
+// Identifiers ([A-Za-z_][A-Za-z0-9_]*) become variables bound at evaluation.
 class Parser {
     string s; size_t i{0};
+    Program* out{nullptr};
     void ws() { while (i < s.size() && isspace(static_cast<unsigned char>(s[i]))) ++i; }
     bool match(char c) { ws(); if (i < s.size() && s[i] == c) { ++i; return true; } return false; }
-    double number() {
+    void number() {
         ws();
-        size_t j = i;
-        if (i < s.size() && (s[i] == '+' || s[i] == '-')) ++i;
-        bool any = false;
-        while (i < s.size() && (isdigit(static_cast<unsigned char>(s[i])) || s[i] == '.')) { any = true; ++i; }
-        if (!any) throw runtime_error("expected number");
-        return stod(s.substr(j, i - j));
+        bool neg = false;
+        if (i < s.size() && (s[i] == '+' || s[i] == '-')) neg = s[i++] == '-';
+        double v = 0.0;
+        const char* end = lex_number(s.data() + i, s.data() + s.size(), v);
+        if (!end) throw runtime_error("expected number");
+        i = static_cast<size_t>(end - s.data());
+        if (i < s.size() && (isdigit(static_cast<unsigned char>(s[i])) || s[i] == '.')) throw runtime_error("malformed number");
+        out->emit(Op::Push, neg ? -v : v);
     }
-    double factor() {
+    void factor() {
         ws();
-        if (match('+')) return factor();
-        if (match('-')) return -factor();
-        if (match('(')) { double v = expr(); if (!match(')')) throw runtime_error("missing ')'"); return v; }
-        return number();
-    }
-    double power() {
-        double v = factor(); ws();
-        while (match('^')) { double r = factor(); v = pow(v, r); ws(); }
-        return v;
+        if (i < s.size() && (isalpha(static_cast<unsigned char>(s[i])) || s[i] == '_')) {
+            size_t j = i;
+            while (i < s.size() && (isalnum(static_cast<unsigned char>(s[i])) || s[i] == '_')) ++i;
+            out->emit(Op::Load, 0.0, out->var_index(s.substr(j, i - j)));
+            return;
+        }
+        if (match('+')) { factor(); return; }
+        if (match('-')) { factor(); out->emit(Op::Neg); return; }
+        if (match('(')) { addsub(); if (!match(')')) throw runtime_error("missing ')'"); return; }
+        number();
+    }
+    void power() {
+        factor(); ws();
+        while (match('^')) { factor(); out->emit(Op::Pow); ws(); }
     }
-    double term() {
-        double v = power(); ws();
+    void term() {
+        power(); ws();
         while (true) {
-            if (match('*')) v *= power();
-            else if (match('/')) v /= power();
-            else if (match('%')) { long long a = static_cast<long long>(v), b = static_cast<long long>(power()); v = static_cast<double>(a % b); }
-            else return v;
+            if (match('*')) { power(); out->emit(Op::Mul); }
+            else if (match('/')) { power(); out->emit(Op::Div); }
+            else if (match('%')) { power(); out->emit(Op::Mod); }
+            else return;
             ws();
         }
     }
-    double addsub() {
-        double v = term(); ws();
+    void addsub() {
+        term(); ws();
         while (true) {
-            if (match('+')) v += term();
-            else if (match('-')) v -= term();
-            else if (i + 1 < s.size() && s[i] == '/' && s[i + 1] == '/') { i += 2; long long a = static_cast<long long>(v), b = static_cast<long long>(term()); v = static_cast<double>(a / b); }
-            else return v;
+            if (match('+')) { term(); out->emit(Op::Add); }
+            else if (match('-')) { term(); out->emit(Op::Sub); }
+            else if (i + 1 < s.size() && s[i] == '/' && s[i + 1] == '/') { i += 2; term(); out->emit(Op::IDiv); }
+            else return;
             ws();
         }
     }
 public:
     explicit Parser(string expr) : s(move(expr)) {}
-    double expr() { return addsub(); }
+    // Parse and evaluate in one go (the old behaviour); prefer compile() when
+    // the same expression is evaluated more than once.
+    double expr() { Program p; out = &p; addsub(); out = nullptr; return p.evaluate(); }
+    Program compile() {
+        Program p; out = &p; addsub(); out = nullptr;
+        if (!finished()) throw runtime_error("trailing characters");
+        p.optimize();
+        return p;
+    }
     bool finished() { ws(); return i == s.size(); }
 };
 
+// -------- Memory-mapped file --------
+// Read-only view of a whole file. POSIX maps it; elsewhere it is read into
+// memory once. An empty file is valid and has size() == 0.
+class MappedFile {
+public:
+    explicit MappedFile(const string& path) {
+#if OS_WIN
+        ifstream in(path, ios::binary);
+        if (!in) return;
+        copy_.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        data_ = copy_.data(); size_ = copy_.size(); ok_ = true;
+#else
+        fd_ = open(path.c_str(), O_RDONLY);
+        if (fd_ < 0) return;
+        struct stat st;
+        if (fstat(fd_, &st) != 0) return;
+        // Pipes, devices and /proc files (which report size 0) can't be
+        // mapped, so those are read into memory instead.
+        if (!S_ISREG(st.st_mode) || st.st_size == 0) { read_all(); return; }
+        size_ = static_cast<size_t>(st.st_size);
+        void* m = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (m == MAP_FAILED) { size_ = 0; return; }
+        madvise(m, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(m);
+        mapped_ = true;
+        ok_ = true;
+#endif
+    }
+    ~MappedFile() {
+#if !OS_WIN
+        if (mapped_) munmap(const_cast<char*>(data_), size_);
+        if (fd_ >= 0) close(fd_);
+#endif
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    bool ok() const { return ok_; }
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+    // -1 when the contents were read rather than mapped.
+    int fd() const { return fd_; }
+private:
+    const char* data_{nullptr};
+    size_t size_{0};
+    int fd_{-1};
+    bool ok_{false}, mapped_{false};
+    string copy_;
+#if !OS_WIN
+    void read_all() {
+        char buf[65536];
+        for (;;) {
+            ssize_t n = ::read(fd_, buf, sizeof(buf));
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) return;
+            if (n == 0) break;
+            copy_.append(buf, static_cast<size_t>(n));
+        }
+        close(fd_);
+        fd_ = -1;
+        data_ = copy_.data(); size_ = copy_.size(); ok_ = true;
+    }
+#endif
+};
+
+// -------- Paging --------
+// Writes [off, off + len) of f to stdout without going through iostreams:
+// sendfile() on Linux (kernel-side copy) for mapped files, otherwise large
+// write() calls straight from memory.
+static void write_range(const MappedFile& f, uint64_t off, uint64_t len) {
+    cout.flush();
+    if (off >= f.size()) return;
+    len = min<uint64_t>(len, f.size() - off);
+#if OS_WIN
+    cout.write(f.data() + off, static_cast<streamsize>(len));
+    cout.flush();
+#else
+  #ifdef __linux__
+    off_t pos = static_cast<off_t>(off);
+    uint64_t left = len;
+    while (left > 0 && f.fd() >= 0) {
+        ssize_t n = sendfile(STDOUT_FILENO, f.fd(), &pos, static_cast<size_t>(min<uint64_t>(left, 1u << 30)));
+        if (n <= 0) break;
+        left -= static_cast<uint64_t>(n);
+    }
+    off += len - left;
+    len = left;
+  #endif
+    const char* p = f.data() + off;
+    while (len > 0) {
+        ssize_t n = write(STDOUT_FILENO, p, static_cast<size_t>(min<uint64_t>(len, 1u << 20)));
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        p += n; len -= static_cast<uint64_t>(n);
+    }
+#endif
+}
+
+// Lazily built line-offset index: the file is scanned only as far as the
+// highest line asked for, and a checkpoint is kept every 1024 lines so later
+// lookups resume from the nearest one. An index is kept per path for the
+// console session; it stays valid while the file only grows.
+class LineIndex {
+public:
+    // Byte offset where (0-based) line n starts; f.size() if there is no such line.
+    uint64_t line_start(const MappedFile& f, uint64_t n) {
+        if (f.size() < size) reset();
+        size = f.size();
+        uint64_t cp = min<uint64_t>(n / STEP, marks.size() - 1);
+        uint64_t line = cp * STEP, off = marks[cp];
+        if (cp == marks.size() - 1 && frontier_line > line && frontier_line <= n) { line = frontier_line; off = frontier; }
+        const char* p = f.data();
+        while (line < n && off < size) {
+            const void* nl = memchr(p + off, '\n', size_t(size - off));
+            if (!nl) { off = size; break; }
+            off = static_cast<uint64_t>(static_cast<const char*>(nl) - p) + 1;
+            ++line;
+            if (line % STEP == 0 && line / STEP == marks.size()) marks.push_back(off);
+            if (line > frontier_line) { frontier_line = line; frontier = off; }
+        }
+        return line == n ? off : size;
+    }
+private:
+    static constexpr uint64_t STEP = 1024;
+    vector<uint64_t> marks{0};
+    uint64_t frontier{0}, frontier_line{0}, size{0};
+    void reset() { marks.assign(1, 0); frontier = frontier_line = 0; }
+};
+
+// Start of the n-th line from the end (a final newline does not open an
+// extra empty line); scans backwards only over those n lines.
+static uint64_t tail_start(const MappedFile& f, uint64_t n) {
+    const char* p = f.data();
+    uint64_t end = f.size();
+    if (n == 0) return end;
+    if (end && p[end - 1] == '\n') --end;
+    while (end > 0) {
+        if (p[end - 1] == '\n' && n-- <= 1) return end;
+        --end;
+    }
+    return 0;
+}
+
+// -------- In-process search --------
+static inline char ascii_lower(char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + 32) : c; }
+
+// Case-insensitive (ASCII) substring finder. The first byte is located with
+// SSE2, 16 bytes at a time (for a letter, OR-ing 0x20 folds both cases onto
+// the lowercase byte), or memchr when it is not a letter; each candidate is
+// then verified byte by byte.
+class Needle {
+public:
+    explicit Needle(const string& s) : n(s) { for (char& c : n) c = ascii_lower(c); }
+    size_t size() const { return n.size(); }
+    const string& text() const { return n; }
+    const char* find(const char* p, const char* end) const {
+        if (n.empty()) return p;
+        const size_t len = n.size();
+        if (static_cast<size_t>(end - p) < len) return nullptr;
+        const char* last = end - len;   // last position a match can start at
+        const char f = n[0];
+        const bool alpha = f >= 'a' && f <= 'z';
+        while (p <= last) {
+            const char* c = alpha ? scan_alpha(p, last + 1) : static_cast<const char*>(memchr(p, f, static_cast<size_t>(last + 1 - p)));
+            if (!c) return nullptr;
+            if (verify(c)) return c;
+            p = c + 1;
+        }
+        return nullptr;
+    }
+private:
+    string n;
+    bool verify(const char* c) const {
+        for (size_t k = 1; k < n.size(); ++k) if (ascii_lower(c[k]) != n[k]) return false;
+        return true;
+    }
+    const char* scan_alpha(const char* p, const char* end) const {
+        const char f = n[0];
+#if defined(__SSE2__)
+        const __m128i fold = _mm_set1_epi8(0x20), want = _mm_set1_epi8(f);
+        for (; p + 16 <= end; p += 16) {
+            __m128i v = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), fold);
+            int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(v, want));
+            if (mask) return p + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+#endif
+        for (; p < end; ++p) if ((*p | 0x20) == f) return p;
+        return nullptr;
+    }
+};
+
+// Collects output lines, each optionally prefixed (e.g. "path:"), and
+// writes them to the stream in 64 KB chunks. Without a stream the lines just
+// accumulate and are taken with take(); discard() drops them (benchmarks).
+class LineWriter {
+public:
+    explicit LineWriter(ostream* o, string pre = "") : os(o), prefix(move(pre)) { if (os) buf.reserve(CHUNK + 4096); }
+    explicit LineWriter(ostream& o) : LineWriter(&o) {}
+    static LineWriter discard() { LineWriter w(nullptr); w.keep = false; return w; }
+    ~LineWriter() { flush(); }
+    void line(const char* b, const char* e) {
+        if (!keep) return;
+        buf += prefix;
+        buf.append(b, e);
+        buf += '\n';
+        if (os && buf.size() >= CHUNK) flush();
+    }
+    void flush() { if (os && !buf.empty()) { os->write(buf.data(), static_cast<streamsize>(buf.size())); buf.clear(); } }
+    string take() { string s; s.swap(buf); return s; }
+private:
+    static constexpr size_t CHUNK = 64 * 1024;
+    ostream* os;
+    string prefix;
+    string buf;
+    bool keep{true};
+};
+
+// Sends every line of [p, end) that contains the needle to out, in order,
+// and returns how many lines matched. Once a line matches the scan resumes
+// at the next line, so each line is reported at most once.
+static size_t grep_buffer(const char* p, const char* end, const Needle& nd, LineWriter& out) {
+    size_t lines = 0;
+    const char* cur = p;
+    while (cur < end) {
+        const char* hit = nd.find(cur, end);
+        if (!hit) break;
+        const char* ls = hit;
+        while (ls > cur && ls[-1] != '\n') --ls;
+        const char* le = static_cast<const char*>(memchr(hit, '\n', static_cast<size_t>(end - hit)));
+        if (!le) le = end;
+        out.line(ls, le);
+        ++lines;
+        cur = le + 1;
+    }
+    return lines;
+}
+
+// Multi-pattern matcher: all patterns (ASCII case-insensitive) are compiled
+// into one dense Aho-Corasick automaton, next[state * 256 + byte], with the
+// uppercase columns copied from the lowercase ones so the scan needs no case
+// folding. dict[] links each state to the nearest suffix state that ends a
+// pattern, so every occurrence of every pattern is counted in one pass.
+class AhoCorasick {
+public:
+    explicit AhoCorasick(const vector<string>& patterns) {
+        next.assign(256, -1);
+        match.push_back(-1);
+        for (const string& raw : patterns) {
+            string p = raw;
+            for (char& c : p) c = ascii_lower(c);
+            if (p.empty() || find(pats.begin(), pats.end(), p) != pats.end()) continue;
+            int32_t s = 0;
+            for (unsigned char c : p) {
+                int32_t& t = next[static_cast<size_t>(s) * 256 + c];
+                if (t < 0) {
+                    t = static_cast<int32_t>(match.size());
+                    match.push_back(-1);
+                    next.resize(next.size() + 256, -1);
+                }
+                s = next[static_cast<size_t>(s) * 256 + c];
+            }
+            match[static_cast<size_t>(s)] = static_cast<int32_t>(pats.size());
+            pats.push_back(p);
+        }
+        size_t states = match.size();
+        vector<int32_t> fail(states, 0);
+        dict.assign(states, -1);
+        deque<int32_t> q;
+        for (size_t c = 0; c < 256; ++c) {
+            if (next[c] < 0) next[c] = 0;
+            else q.push_back(next[c]);
+        }
+        while (!q.empty()) {
+            size_t s = static_cast<size_t>(q.front()); q.pop_front();
+            for (size_t c = 0; c < 256; ++c) {
+                int32_t& t = next[s * 256 + c];
+                int32_t via = next[static_cast<size_t>(fail[s]) * 256 + c];
+                if (t < 0) { t = via; continue; }
+                fail[static_cast<size_t>(t)] = via;
+                dict[static_cast<size_t>(t)] = match[static_cast<size_t>(via)] >= 0 ? via : dict[static_cast<size_t>(via)];
+                q.push_back(t);
+            }
+        }
+        hit.assign(states, 0);
+        for (size_t s = 0; s < states; ++s) {
+            for (size_t c = 'A'; c <= 'Z'; ++c) next[s * 256 + c] = next[s * 256 + c + 32];
+            hit[s] = match[s] >= 0 || dict[s] >= 0;
+        }
+    }
+    size_t size() const { return pats.size(); }
+    const string& pattern(size_t i) const { return pats[i]; }
+
+    // Emits each line with at least one match once and adds every occurrence
+    // to hits[pattern]; returns the number of matching lines.
+    size_t grep(const char* p, const char* end, LineWriter& out, vector<size_t>& hits) const {
+        size_t lines = 0;
+        int32_t s = 0;
+        const char* line_start = p;
+        const char* emitted = nullptr;
+        const int32_t* tab = next.data();
+        for (const char* q = p; q < end; ++q) {
+            unsigned char c = static_cast<unsigned char>(*q);
+            s = tab[static_cast<size_t>(s) * 256 + c];
+            if (c == '\n') { line_start = q + 1; continue; }
+            if (!hit[static_cast<size_t>(s)]) continue;
+            for (int32_t t = match[static_cast<size_t>(s)] >= 0 ? s : dict[static_cast<size_t>(s)]; t >= 0; t = dict[static_cast<size_t>(t)])
+                ++hits[static_cast<size_t>(match[static_cast<size_t>(t)])];
+            if (emitted != line_start) {
+                const char* le = static_cast<const char*>(memchr(q, '\n', static_cast<size_t>(end - q)));
+                out.line(line_start, le ? le : end);
+                emitted = line_start;
+                ++lines;
+            }
+        }
+        return lines;
+    }
+private:
+    vector<string> pats;
+    vector<int32_t> next, match, dict;
+    vector<unsigned char> hit;
+};
+
+// What sfile looks for: one needle, or a pattern list matched in a single
+// pass. hits has one slot per pattern (a needle counts matching lines).
+class Query {
+public:
+    explicit Query(const string& s) : needle(s) {}
+    explicit Query(const vector<string>& patterns) : needle(""), ac(make_unique<AhoCorasick>(patterns)) {}
+    size_t patterns() const { return ac ? ac->size() : 1; }
+    string pattern(size_t i) const { return ac ? ac->pattern(i) : needle.text(); }
+    vector<string> pattern_list() const {
+        vector<string> v;
+        for (size_t i = 0; i < patterns(); ++i) v.push_back(pattern(i));
+        return v;
+    }
+    bool multi() const { return ac != nullptr; }
+    size_t grep(const char* p, const char* end, LineWriter& out, vector<size_t>& hits) const {
+        if (ac) return ac->grep(p, end, out, hits);
+        size_t n = grep_buffer(p, end, needle, out);
+        hits[0] += n;
+        return n;
+    }
+private:
+    Needle needle;
+    unique_ptr<AhoCorasick> ac;
+};
+
+// -------- Trigram index --------
+// Optional sidecar "<file>.tgi" that lets sfile skip blocks which cannot
+// contain the search string. The file is cut into ~64 KB blocks that always
+// end on a newline; every case-folded trigram of a block sets one of 65536
+// bloom bits. Blocks are grouped 512 to a fixed-size segment whose bits are
+// stored transposed (bit -> 512-bit block mask), so a query ANDs one 64-byte
+// row per trigram per segment. Because segments are fixed-size and the file
+// only grows, a refresh rewrites just the last segment and appends new ones.
+// A trailing partial line is never indexed; sfile scans everything past the
+// indexed prefix directly, so a stale index is still correct.
+class TrigramIndex {
+public:
+    static constexpr uint32_t BLOCK = 64 * 1024, BITS = 65536, SEG_BLOCKS = 512;
+    static constexpr size_t WORDS = SEG_BLOCKS / 64;                              // u64 per bloom row
+    static constexpr size_t HEADER = 64;
+    static constexpr size_t SEG_TABLE = SEG_BLOCKS * 2 * sizeof(uint64_t);         // (offset, length) pairs
+    static constexpr size_t SEG_BYTES = SEG_TABLE + size_t(BITS) * WORDS * sizeof(uint64_t);
+
+    static string path_for(const string& file) { return file + ".tgi"; }
+
+    // Opens the index of data, if there is one and it still describes data.
+    TrigramIndex(const string& file, const MappedFile& data) : idx(path_for(file)) {
+        if (!idx.ok() || idx.size() < HEADER) return;
+        Header h;
+        memcpy(&h, idx.data(), sizeof(h));
+        if (!h.valid() || h.indexed > data.size() || h.head != head_hash(data, h.indexed)) return;
+        if (idx.size() < HEADER + segments_for(h.blocks) * SEG_BYTES) return;
+        hdr = h; ok_ = true;
+    }
+    bool ok() const { return ok_; }
+    uint64_t indexed() const { return hdr.indexed; }
+    uint64_t blocks() const { return hdr.blocks; }
+
+    // Calls scan(offset, length) for every block that may contain one of the
+    // (lowercase) patterns, in file order; returns the number of blocks. Only
+    // usable when every pattern has at least three bytes.
+    static bool usable(const vector<string>& pats) {
+        if (pats.empty()) return false;
+        for (const string& p : pats) if (p.size() < 3) return false;
+        return true;
+    }
+    size_t candidates(const vector<string>& pats, const function<void(uint64_t, uint64_t)>& scan) const {
+        vector<vector<uint32_t>> bits;
+        for (const string& p : pats) {
+            vector<uint32_t> b;
+            for (size_t k = 0; k + 2 < p.size(); ++k) b.push_back(tri_bit(p[k], p[k + 1], p[k + 2]));
+            sort(b.begin(), b.end());
+            b.erase(unique(b.begin(), b.end()), b.end());
+            bits.push_back(move(b));
+        }
+        size_t hits = 0;
+        for (uint64_t s = 0; s < segments_for(hdr.blocks); ++s) {
+            const char* seg = idx.data() + HEADER + s * SEG_BYTES;
+            const uint64_t* table = reinterpret_cast<const uint64_t*>(seg);
+            const uint64_t* rows = reinterpret_cast<const uint64_t*>(seg + SEG_TABLE);
+            uint64_t n = min<uint64_t>(SEG_BLOCKS, hdr.blocks - s * SEG_BLOCKS);
+            uint64_t cand[WORDS] = {};
+            for (const auto& b : bits) {
+                uint64_t m[WORDS];
+                fill(m, m + WORDS, ~0ULL);
+                for (uint32_t bit : b) for (size_t w = 0; w < WORDS; ++w) m[w] &= rows[size_t(bit) * WORDS + w];
+                for (size_t w = 0; w < WORDS; ++w) cand[w] |= m[w];
+            }
+            for (uint64_t j = 0; j < n; ++j) {
+                if (!(cand[j / 64] >> (j % 64) & 1)) continue;
+                scan(table[2 * j], table[2 * j + 1]);
+                ++hits;
+            }
+        }
+        return hits;
+    }
+
+    // Builds the index for file, or brings an existing one up to date.
+    // reused/added report how many blocks were kept and (re)built.
+    static bool refresh(const string& file, const MappedFile& data, uint64_t& reused, uint64_t& added, string& err) {
+        const string path = path_for(file);
+        Header h{};
+        uint64_t start = 0;       // first byte to (re)index
+        uint64_t first_seg = 0;   // first segment to (re)write
+        {
+            MappedFile old(path);
+            Header o;
+            if (old.ok() && old.size() >= HEADER) {
+                memcpy(&o, old.data(), sizeof(o));
+                if (o.valid() && o.indexed <= data.size() && o.head == head_hash(data, o.indexed) &&
+                    old.size() >= HEADER + segments_for(o.blocks) * SEG_BYTES) {
+                    h = o;
+                    first_seg = o.blocks / SEG_BLOCKS;
+                    if (first_seg < segments_for(o.blocks))   // partial last segment: rebuild it from its first block
+                        memcpy(&start, old.data() + HEADER + first_seg * SEG_BYTES, sizeof(start));
+                    else start = o.indexed;
+                }
+            }
+        }
+        reused = first_seg * SEG_BLOCKS;
+        fstream out;
+        if (reused) out.open(path, ios::in | ios::out | ios::binary);
+        if (!out.is_open()) { reused = 0; first_seg = 0; start = 0; out.open(path, ios::out | ios::trunc | ios::binary); }
+        if (!out) { err = "cannot write " + path; return false; }
+
+        // Invalidate the header while segments are rewritten.
+        Header dead{};
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&dead), sizeof(dead));
+        out.write(string(HEADER - sizeof(dead), '\0').data(), HEADER - sizeof(dead));
+
+        const char* p = data.data();
+        const uint64_t size = data.size();
+        uint64_t end = size;
+        while (end > start && p[end - 1] != '\n') --end;    // index whole lines only
+
+        vector<uint64_t> table(SEG_BLOCKS * 2);
+        vector<uint64_t> rows(size_t(BITS) * WORDS);
+        uint64_t seg = first_seg, off = start, blocks = reused;
+        while (off < end) {
+            fill(table.begin(), table.end(), 0);
+            fill(rows.begin(), rows.end(), 0);
+            uint32_t j = 0;
+            for (; j < SEG_BLOCKS && off < end; ++j) {
+                uint64_t stop = min<uint64_t>(off + BLOCK, end);
+                if (stop < end) {
+                    const void* nl = memchr(p + stop - 1, '\n', size_t(end - stop + 1));
+                    stop = static_cast<uint64_t>(static_cast<const char*>(nl) - p) + 1;
+                }
+                table[2 * j] = off; table[2 * j + 1] = stop - off;
+                for (uint64_t k = off; k + 2 < stop; ++k)
+                    rows[size_t(tri_bit(p[k], p[k + 1], p[k + 2])) * WORDS + j / 64] |= 1ULL << (j % 64);
+                off = stop;
+            }
+            out.seekp(static_cast<streamoff>(HEADER + seg * SEG_BYTES));
+            out.write(reinterpret_cast<const char*>(table.data()), static_cast<streamsize>(SEG_TABLE));
+            out.write(reinterpret_cast<const char*>(rows.data()), static_cast<streamsize>(rows.size() * sizeof(uint64_t)));
+            blocks = seg * SEG_BLOCKS + j;
+            ++seg;
+        }
+
+        memcpy(h.magic, MAGIC, sizeof(h.magic));
+        h.version = 1; h.block = BLOCK; h.bits = BITS; h.seg_blocks = SEG_BLOCKS;
+        h.blocks = blocks;
+        h.indexed = blocks ? end : 0;
+        h.head = head_hash(data, h.indexed);
+        out.seekp(0);
+        out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+        out.flush();
+        if (!out) { err = "write failed for " + path; return false; }
+        added = blocks - reused;
+        return true;
+    }
+
+private:
+    static constexpr char MAGIC[8] = {'C', 'H', 'T', 'G', 'I', 'D', 'X', '\0'};
+    struct Header {
+        char magic[8];
+        uint32_t version, block, bits, seg_blocks;
+        uint64_t blocks, indexed, head;
+        bool valid() const {
+            return memcmp(magic, MAGIC, sizeof(magic)) == 0 && version == 1 && block == BLOCK && bits == BITS && seg_blocks == SEG_BLOCKS;
+        }
+    };
+    static_assert(sizeof(Header) <= HEADER, "header must fit");
+
+    MappedFile idx;
+    Header hdr{};
+    bool ok_{false};
+
+    static uint64_t segments_for(uint64_t blocks) { return (blocks + SEG_BLOCKS - 1) / SEG_BLOCKS; }
+    static uint32_t tri_bit(char a, char b, char c) {
+        uint32_t x = (uint32_t(static_cast<unsigned char>(ascii_lower(a))) << 16) |
+                     (uint32_t(static_cast<unsigned char>(ascii_lower(b))) << 8) |
+                      uint32_t(static_cast<unsigned char>(ascii_lower(c)));
+        return (x * 2654435761u) >> 16;
+    }
+    // FNV-1a of the first 4 KB of the indexed prefix: detects a rotated or
+    // rewritten file whose size happens to still be large enough.
+    static uint64_t head_hash(const MappedFile& data, uint64_t indexed) {
+        uint64_t h = 1469598103934665603ULL;
+        for (uint64_t k = 0; k < min<uint64_t>(indexed, 4096); ++k) { h ^= static_cast<unsigned char>(data.data()[k]); h *= 1099511628211ULL; }
+        return h;
+    }
+};
+
+// -------- ChaCha20 CSPRNG --------
+// ChaCha20 keystream (original layout: 64-bit block counter, 64-bit stream
+// id) used as a random byte source. The key is drawn from the OS once per
+// process; each user takes its own stream id, so threads never share state.
+class ChaCha20 {
+public:
+    ChaCha20(const array<uint8_t, 32>& key, uint64_t stream) {
+        s[0] = 0x61707865; s[1] = 0x3320646e; s[2] = 0x79622d32; s[3] = 0x6b206574;
+        for (int i = 0; i < 8; ++i) s[4 + i] = le32(key.data() + 4 * i);
+        s[12] = s[13] = 0;
+        s[14] = static_cast<uint32_t>(stream); s[15] = static_cast<uint32_t>(stream >> 32);
+    }
+
+    // Engine on the process key; stream ids come from a global counter.
+    static ChaCha20 make() {
+        static const array<uint8_t, 32> key = os_key();
+        static atomic<uint64_t> next_stream{0};
+        return ChaCha20(key, next_stream++);
+    }
+
+    void fill(uint8_t* out, size_t n) {
+        while (n) {
+            if (pos == 64) { block(); pos = 0; }
+            size_t k = min(n, 64 - pos);
+            memcpy(out, buf + pos, k);
+            out += k; n -= k; pos += k;
+        }
+    }
+
+    // Uniform in [0, n) for 1 <= n <= 256: bytes at or above the largest
+    // multiple of n are rejected, so there is no modulo bias.
+    unsigned below(unsigned n) {
+        const unsigned limit = 256 - 256 % n;
+        for (;;) {
+            if (pos == 64) { block(); pos = 0; }
+            unsigned b = buf[pos++];
+            if (b < limit) return b % n;
+        }
+    }
+
+private:
+    uint32_t s[16];
+    uint8_t buf[64];
+    size_t pos{64};
+
+    static uint32_t le32(const uint8_t* p) { return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24; }
+    static uint32_t rotl(uint32_t v, int c) { return (v << c) | (v >> (32 - c)); }
+    static void qr(uint32_t& a, uint32_t& b, uint32_t& c, uint32_t& d) {
+        a += b; d = rotl(d ^ a, 16); c += d; b = rotl(b ^ c, 12);
+        a += b; d = rotl(d ^ a, 8);  c += d; b = rotl(b ^ c, 7);
+    }
+    void block() {
+        uint32_t x[16];
+        memcpy(x, s, sizeof x);
+        for (int i = 0; i < 10; ++i) {
+            qr(x[0], x[4], x[8], x[12]); qr(x[1], x[5], x[9], x[13]); qr(x[2], x[6], x[10], x[14]); qr(x[3], x[7], x[11], x[15]);
+            qr(x[0], x[5], x[10], x[15]); qr(x[1], x[6], x[11], x[12]); qr(x[2], x[7], x[8], x[13]); qr(x[3], x[4], x[9], x[14]);
+        }
+        for (int i = 0; i < 16; ++i) {
+            uint32_t v = x[i] + s[i];
+            buf[4 * i] = uint8_t(v); buf[4 * i + 1] = uint8_t(v >> 8); buf[4 * i + 2] = uint8_t(v >> 16); buf[4 * i + 3] = uint8_t(v >> 24);
+        }
+        if (++s[12] == 0) ++s[13];
+    }
+
+    static array<uint8_t, 32> os_key() {
+        array<uint8_t, 32> k{};
+        size_t got = 0;
+#ifdef __linux__
+        while (got < k.size()) {
+            ssize_t n = getrandom(k.data() + got, k.size() - got, 0);
+            if (n < 0) { if (errno == EINTR) continue; break; }
+            got += static_cast<size_t>(n);
+        }
+#endif
+        if (got < k.size()) {
+            random_device rd;
+            for (size_t i = 0; i < k.size(); i += 4) {
+                uint32_t v = rd();
+                memcpy(k.data() + i, &v, 4);
+            }
+        }
+        return k;
+    }
+};
+
+// -------- Work-stealing thread pool --------
+// Runs task(0..n-1) on a fixed set of workers. Indices are dealt round-robin
+// into per-worker deques; a worker takes from the front of its own deque
+// (so low indices tend to finish first) and, once it runs dry, steals from
+// the back of the others'. All tasks are known up front, so a worker exits
+// when every deque is empty.
+class WorkStealingPool {
+public:
+    WorkStealingPool(size_t threads, size_t n, function<void(size_t)> task)
+        : queues(max<size_t>(threads, 1)), job(move(task)) {
+        for (size_t i = 0; i < n; ++i) queues[i % queues.size()].items.push_back(i);
+        for (size_t w = 0; w < queues.size(); ++w) workers.emplace_back([this, w] { work(w); });
+    }
+    ~WorkStealingPool() { wait(); }
+    void wait() { for (auto& t : workers) if (t.joinable()) t.join(); }
+private:
+    struct Queue { mutex m; deque<size_t> items; };
+    vector<Queue> queues;
+    vector<thread> workers;
+    function<void(size_t)> job;
+
+    bool pop(size_t w, size_t& i) {
+        Queue& q = queues[w];
+        lock_guard<mutex> lock(q.m);
+        if (q.items.empty()) return false;
+        i = q.items.front(); q.items.pop_front();
+        return true;
+    }
+    bool steal(size_t w, size_t& i) {
+        for (size_t k = 1; k < queues.size(); ++k) {
+            Queue& q = queues[(w + k) % queues.size()];
+            lock_guard<mutex> lock(q.m);
+            if (q.items.empty()) continue;
+            i = q.items.back(); q.items.pop_back();
+            return true;
+        }
+        return false;
+    }
+    void work(size_t w) {
+        size_t i;
+        while (pop(w, i) || steal(w, i)) job(i);
+    }
+};
+
+// Shell-style glob with '*' and '?'.
+static bool glob_match(const char* g, const char* s) {
+    const char* star = nullptr;
+    const char* resume = nullptr;
+    while (*s) {
+        if (*g == '?' || *g == *s) { ++g; ++s; }
+        else if (*g == '*') { star = g++; resume = s; }
+        else if (star) { g = star + 1; s = ++resume; }
+        else return false;
+    }
+    while (*g == '*') ++g;
+    return *g == '\0';
+}
+
+// Comma-separated glob list; a glob containing '/' is matched against the
+// path relative to the search root, anything else against the file name.
+static bool glob_any(const vector<string>& globs, const string& rel, const string& name) {
+    for (const string& g : globs)
+        if (glob_match(g.c_str(), (g.find('/') != string::npos ? rel : name).c_str())) return true;
+    return false;
+}
+
+static vector<string> split_list(const string& s) {
+    vector<string> out;
+    istringstream is(s);
+    string item;
+    while (getline(is, item, ',')) {
+        size_t a = item.find_first_not_of(" \t"), b = item.find_last_not_of(" \t");
+        if (a != string::npos) out.push_back(item.substr(a, b - a + 1));
+    }
+    return out;
+}
+
+// -------- Process execution --------
+// Runs shell commands concurrently and captures stdout and stderr
+// separately. On POSIX each command is started with posix_spawn("/bin/sh -c")
+// in its own process group, all pipes are multiplexed with poll() and read
+// 64 KB at a time into growable strings. A command that outlives its timeout
+// (or every command, once *cancel is set) has its process group killed.
+struct ProcResult {
+    string cmd, out, err;
+    int status{-1};           // exit code, or 128 + signal
+    bool started{false}, timed_out{false}, cancelled{false};
+    double start_secs{0.0};   // when it was spawned, relative to the run_all call
+    double secs{0.0};
+};
+
+class ProcessRunner {
+public:
+    // timeout_ms <= 0 means no timeout; max_parallel == 0 means all at once.
+    // Results come back in the order of cmds.
+    static vector<ProcResult> run_all(const vector<string>& cmds, int timeout_ms = 0,
+                                      const atomic<bool>* cancel = nullptr, size_t max_parallel = 0) {
+        vector<ProcResult> res(cmds.size());
+        for (size_t i = 0; i < cmds.size(); ++i) res[i].cmd = cmds[i];
+        const auto base = chrono::steady_clock::now();
+#if OS_WIN
+        for (auto& r : res) {
+            if (cancel && *cancel) { r.cancelled = true; continue; }
+            auto t0 = chrono::steady_clock::now();
+            r.start_secs = chrono::duration<double>(t0 - base).count();
+            FILE* fp = _popen(r.cmd.c_str(), "r");
+            if (!fp) continue;
+            r.started = true;
+            char buf[1 << 16];
+            size_t n;
+            while ((n = fread(buf, 1, sizeof(buf), fp)) > 0) r.out.append(buf, n);
+            r.status = _pclose(fp);
+            r.secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        }
+        (void)timeout_ms; (void)max_parallel;
+#else
+        using clk = chrono::steady_clock;
+        struct Live { size_t idx; pid_t pid; int fd[2]; clk::time_point start; bool killed; };
+        vector<Live> live;
+        size_t next = 0;
+        const size_t window = max_parallel ? max_parallel : cmds.size();
+        vector<char> buf(1 << 16);
+        while (next < cmds.size() || !live.empty()) {
+            while (next < cmds.size() && live.size() < window) {
+                if (cancel && *cancel) { res[next++].cancelled = true; continue; }
+                Live l{next, -1, {-1, -1}, clk::now(), false};
+                res[next].start_secs = chrono::duration<double>(l.start - base).count();
+                if (spawn(cmds[next], l.pid, l.fd)) { res[next].started = true; live.push_back(l); }
+                ++next;
+            }
+            if (live.empty()) continue;
+
+            vector<pollfd> pfds;
+            vector<pair<size_t, int>> owner;
+            for (size_t k = 0; k < live.size(); ++k)
+                for (int s = 0; s < 2; ++s)
+                    if (live[k].fd[s] >= 0) { pfds.push_back({live[k].fd[s], POLLIN, 0}); owner.push_back({k, s}); }
+            int wait_ms = 50;
+            if (timeout_ms > 0) {
+                for (auto& l : live) {
+                    auto left = chrono::duration_cast<chrono::milliseconds>(l.start + chrono::milliseconds(timeout_ms) - clk::now()).count();
+                    wait_ms = static_cast<int>(max<long long>(0, min<long long>(wait_ms, left)));
+                }
+            }
+            if (!pfds.empty()) {
+                if (poll(pfds.data(), pfds.size(), wait_ms) < 0 && errno != EINTR) break;
+            } else {
+                this_thread::sleep_for(chrono::milliseconds(min(wait_ms, 5)));
+            }
+            for (size_t j = 0; j < pfds.size(); ++j) {
+                if (!(pfds[j].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+                Live& l = live[owner[j].first];
+                int& fd = l.fd[owner[j].second];
+                string& dst = owner[j].second ? res[l.idx].err : res[l.idx].out;
+                for (;;) {
+                    ssize_t n = read(fd, buf.data(), buf.size());
+                    if (n > 0) { dst.append(buf.data(), static_cast<size_t>(n)); continue; }
+                    if (n < 0 && (errno == EINTR)) continue;
+                    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+                    close(fd); fd = -1;   // EOF or error
+                    break;
+                }
+            }
+            bool stop = cancel && *cancel;
+            for (size_t k = 0; k < live.size();) {
+                Live& l = live[k];
+                ProcResult& r = res[l.idx];
+                if (!l.killed && (stop || (timeout_ms > 0 && clk::now() - l.start >= chrono::milliseconds(timeout_ms)))) {
+                    kill(-l.pid, SIGKILL);
+                    l.killed = true;
+                    (stop ? r.cancelled : r.timed_out) = true;
+                }
+                int st = 0;
+                pid_t w = (l.fd[0] < 0 && l.fd[1] < 0) || l.killed ? waitpid(l.pid, &st, l.killed ? 0 : WNOHANG) : 0;
+                if (w == l.pid) {
+                    for (int s = 0; s < 2; ++s) if (l.fd[s] >= 0) close(l.fd[s]);
+                    r.status = WIFEXITED(st) ? WEXITSTATUS(st) : 128 + (WIFSIGNALED(st) ? WTERMSIG(st) : 0);
+                    r.secs = chrono::duration<double>(clk::now() - l.start).count();
+                    live.erase(live.begin() + static_cast<ptrdiff_t>(k));
+                } else ++k;
+            }
+        }
+#endif
+        return res;
+    }
+
+private:
+#if !OS_WIN
+    static bool spawn(const string& cmd, pid_t& pid, int fd[2]) {
+        int po[2], pe[2];
+        if (pipe(po) != 0) return false;
+        if (pipe(pe) != 0) { close(po[0]); close(po[1]); return false; }
+        posix_spawn_file_actions_t fa;
+        posix_spawn_file_actions_init(&fa);
+        posix_spawn_file_actions_addopen(&fa, 0, "/dev/null", O_RDONLY, 0);
+        posix_spawn_file_actions_adddup2(&fa, po[1], 1);
+        posix_spawn_file_actions_adddup2(&fa, pe[1], 2);
+        for (int f : {po[0], po[1], pe[0], pe[1]}) posix_spawn_file_actions_addclose(&fa, f);
+        posix_spawnattr_t at;
+        posix_spawnattr_init(&at);
+        posix_spawnattr_setflags(&at, POSIX_SPAWN_SETPGROUP);
+        posix_spawnattr_setpgroup(&at, 0);
+        const char* argv[] = { "sh", "-c", cmd.c_str(), nullptr };
+        int rc = posix_spawn(&pid, "/bin/sh", &fa, &at, const_cast<char* const*>(argv), environ);
+        posix_spawn_file_actions_destroy(&fa);
+        posix_spawnattr_destroy(&at);
+        close(po[1]); close(pe[1]);
+        if (rc != 0) { close(po[0]); close(pe[0]); return false; }
+        fd[0] = po[0]; fd[1] = pe[0];
+        for (int s = 0; s < 2; ++s) {
+            fcntl(fd[s], F_SETFL, fcntl(fd[s], F_GETFL) | O_NONBLOCK);
+            fcntl(fd[s], F_SETFD, FD_CLOEXEC);
+        }
+        return true;
+    }
+#endif
+};
+
+// -------- Section reports --------
+// One collector's output plus when and how long it ran. Written as the legacy
+// concatenated text, as JSON, or as a length-prefixed binary file:
+//   "LSI1" u32 count, then per section: u32 len + name, u32 len + command,
+//   i32 status, u8 timed_out, f64 start_secs, f64 secs, u64 len + stdout,
+//   u64 len + stderr (all little-endian).
+struct Section {
+    string name;
+    ProcResult res;
+};
+
+// Length of the well-formed UTF-8 sequence at s[i], or 0 if it is not one
+// (overlong forms, surrogates and code points past U+10FFFF included).
+static size_t utf8_len(const string& s, size_t i) {
+    unsigned char c = static_cast<unsigned char>(s[i]);
+    size_t n = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 0;
+    if (!n || c > 0xF4 || c == 0xC0 || c == 0xC1 || i + n > s.size()) return 0;
+    uint32_t cp = c & (0x7F >> n);
+    for (size_t k = 1; k < n; ++k) {
+        unsigned char t = static_cast<unsigned char>(s[i + k]);
+        if ((t & 0xC0) != 0x80) return 0;
+        cp = (cp << 6) | (t & 0x3F);
+    }
+    static const uint32_t min_cp[] = {0, 0, 0x80, 0x800, 0x10000};
+    if (cp < min_cp[n] || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) return 0;
+    return n;
+}
+
+// Command output is arbitrary bytes; anything that is not valid UTF-8 is
+// replaced with U+FFFD so the report stays valid JSON.
+static string json_escape(const string& s) {
+    string o; o.reserve(s.size() + 16);
+    for (size_t i = 0; i < s.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c >= 0x80) {
+            size_t n = utf8_len(s, i);
+            if (n) { o.append(s, i, n); i += n - 1; }
+            else o += "\\ufffd";
+            continue;
+        }
+        switch (c) {
+        case '"': o += "\\\""; break;
+        case '\\': o += "\\\\"; break;
+        case '\n': o += "\\n"; break;
+        case '\r': o += "\\r"; break;
+        case '\t': o += "\\t"; break;
+        default:
+            if (c < 0x20) { char b[8]; snprintf(b, sizeof b, "\\u%04x", c); o += b; }
+            else o += char(c);
+        }
+    }
+    return o;
+}
+
+static void write_sections_json(ostream& out, const vector<Section>& secs, double total_secs) {
+    out << "{\n  \"total_secs\": " << total_secs << ",\n  \"sections\": [";
+    for (size_t i = 0; i < secs.size(); ++i) {
+        const Section& s = secs[i];
+        out << (i ? ",\n" : "\n") << "    {\"name\": \"" << json_escape(s.name)
+            << "\", \"command\": \"" << json_escape(s.res.cmd)
+            << "\", \"status\": " << s.res.status
+            << ", \"timed_out\": " << (s.res.timed_out ? "true" : "false")
+            << ", \"start_secs\": " << s.res.start_secs
+            << ", \"secs\": " << s.res.secs
+            << ", \"stdout\": \"" << json_escape(s.res.out)
+            << "\", \"stderr\": \"" << json_escape(s.res.err) << "\"}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+static void write_sections_bin(ostream& out, const vector<Section>& secs) {
+    auto put = [&](uint64_t v, int bytes) {
+        char b[8];
+        for (int i = 0; i < bytes; ++i) b[i] = char(v >> (8 * i));
+        out.write(b, bytes);
+    };
+    auto put_f64 = [&](double d) { uint64_t v; memcpy(&v, &d, 8); put(v, 8); };
+    auto put_str = [&](const string& s, int lenbytes) { put(s.size(), lenbytes); out.write(s.data(), (streamsize)s.size()); };
+    out.write("LSI1", 4);
+    put(secs.size(), 4);
+    for (const Section& s : secs) {
+        put_str(s.name, 4);
+        put_str(s.res.cmd, 4);
+        put(uint32_t(int32_t(s.res.status)), 4);
+        put(s.res.timed_out ? 1 : 0, 1);
+        put_f64(s.res.start_secs);
+        put_f64(s.res.secs);
+        put_str(s.res.out, 8);
+        put_str(s.res.err, 8);
+    }
+}
+
+// -------- Socket table --------
+#if !OS_WIN
+// Reads /proc/net/{tcp,tcp6,udp,udp6} into a flat array and indexes it by
+// local port. Inode -> PID/command is only resolved when something is printed,
+// since walking /proc/*/fd is the expensive part.
+struct SockEntry {
+    uint8_t proto;          // 0 tcp, 1 tcp6, 2 udp, 3 udp6
+    uint8_t state;          // kernel TCP state number (UDP: 7 unconnected, 1 connected)
+    uint16_t lport, rport;
+    array<uint8_t, 16> laddr, raddr;   // network byte order; v4 uses the first 4
+    uint64_t inode;
+};
+
+// Local endpoint identity used by port-watch snapshots.
+struct SockKey {
+    uint8_t proto;
+    uint16_t port;
+    array<uint8_t, 16> addr;
+    bool operator==(const SockKey& o) const { return proto == o.proto && port == o.port && addr == o.addr; }
+};
+struct SockKeyHash {
+    size_t operator()(const SockKey& k) const {
+        uint64_t h = 1469598103934665603ull;   // FNV-1a
+        auto mix = [&](uint8_t b) { h = (h ^ b) * 1099511628211ull; };
+        mix(k.proto); mix(uint8_t(k.port)); mix(uint8_t(k.port >> 8));
+        for (uint8_t b : k.addr) mix(b);
+        return static_cast<size_t>(h);
+    }
+};
+struct PortState {
+    bool listening{false};
+    unsigned conns{0};      // non-listening sockets on this endpoint
+    uint64_t inode{0};      // listener's inode, for owner lookup
+};
+using PortSnapshot = unordered_map<SockKey, PortState, SockKeyHash>;
+
+class SocketTable {
+public:
+    static constexpr const char* PROTO[4] = { "tcp", "tcp6", "udp", "udp6" };
+
+    // Re-reads every table; false if none of them could be read.
+    bool load() {
+        ents.clear(); by_port.clear(); owners.clear(); owners_loaded = false;
+        bool any = false;
+#ifdef __linux__
+        for (uint8_t p = 0; p < 4; ++p) {
+            string text;
+            if (!slurp(string("/proc/net/") + PROTO[p], text)) continue;
+            any = true;
+            parse(text, p);
+        }
+#endif
+        by_port.resize(ents.size());
+        for (uint32_t i = 0; i < by_port.size(); ++i) by_port[i] = i;
+        sort(by_port.begin(), by_port.end(), [&](uint32_t a, uint32_t b) { return ents[a].lport < ents[b].lport; });
+        return any;
+    }
+
+    const vector<SockEntry>& entries() const { return ents; }
+
+    // Entries whose local port is exactly `port`.
+    vector<const SockEntry*> on_port(uint16_t port) const {
+        auto lo = lower_bound(by_port.begin(), by_port.end(), port, [&](uint32_t i, uint16_t p) { return ents[i].lport < p; });
+        vector<const SockEntry*> out;
+        for (; lo != by_port.end() && ents[*lo].lport == port; ++lo) out.push_back(&ents[*lo]);
+        return out;
+    }
+
+    // "pid/comm" of the process holding the socket, or "-" if unknown
+    // (other users' processes are unreadable without root).
+    string owner(uint64_t inode) {
+        if (!owners_loaded) load_owners();
+        auto it = owners.find(inode);
+        return it == owners.end() ? "-" : it->second;
+    }
+
+    static bool listening(const SockEntry& e) { return e.proto >= 2 ? e.state == 7 && e.rport == 0 : e.state == 10; }
+
+    // Connections are only counted on ports something listens on, so the
+    // ephemeral client side of outgoing connections does not show up.
+    PortSnapshot snapshot() const {
+        PortSnapshot s;
+        vector<bool> served(4 * 65536);
+        for (const SockEntry& e : ents)
+            if (listening(e)) {
+                served[e.proto * 65536u + e.lport] = true;
+                PortState& st = s[SockKey{e.proto, e.lport, e.laddr}];
+                st.listening = true; st.inode = e.inode;
+            }
+        for (const SockEntry& e : ents)
+            if (!listening(e) && served[e.proto * 65536u + e.lport]) ++s[SockKey{e.proto, e.lport, e.laddr}].conns;
+        return s;
+    }
+
+    static const char* state_name(const SockEntry& e) {
+        static const char* TCP[] = { "?", "ESTABLISHED", "SYN_SENT", "SYN_RECV", "FIN_WAIT1", "FIN_WAIT2",
+                                     "TIME_WAIT", "CLOSE", "CLOSE_WAIT", "LAST_ACK", "LISTEN", "CLOSING" };
+        if (e.proto >= 2) return e.state == 7 ? "UNCONN" : "ESTAB";
+        return e.state < 12 ? TCP[e.state] : "?";
+    }
+
+    static string endpoint(uint8_t proto, const array<uint8_t, 16>& addr, uint16_t port) {
+        char buf[INET6_ADDRSTRLEN] = "?";
+        inet_ntop(proto & 1 ? AF_INET6 : AF_INET, addr.data(), buf, sizeof buf);
+        return string(proto & 1 ? "[" : "") + buf + (proto & 1 ? "]:" : ":") + (port ? to_string(port) : "*");
+    }
+
+    string format(const SockEntry& e) {
+        ostringstream os;
+        os << left << setw(5) << PROTO[e.proto] << " " << setw(23) << endpoint(e.proto, e.laddr, e.lport) << " "
+           << setw(23) << endpoint(e.proto, e.raddr, e.rport) << " " << setw(11) << state_name(e) << " " << owner(e.inode);
+        return os.str();
+    }
+
+private:
+    vector<SockEntry> ents;
+    vector<uint32_t> by_port;     // indices into ents, sorted by local port
+    unordered_map<uint64_t, string> owners;
+    bool owners_loaded{false};
+
+    static bool slurp(const string& path, string& out) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        char buf[1 << 16];
+        ssize_t n;
+        while ((n = read(fd, buf, sizeof buf)) > 0) out.append(buf, static_cast<size_t>(n));
+        close(fd);
+        return true;
+    }
+
+    static int hexval(char c) {
+        return c >= '0' && c <= '9' ? c - '0' : c >= 'A' && c <= 'F' ? c - 'A' + 10 : c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+    }
+    // Parses `digits` hex chars at p, advancing it; -1 on malformed input.
+    static long long hex(const char*& p, int digits) {
+        long long v = 0;
+        for (int i = 0; i < digits; ++i) { int h = hexval(*p++); if (h < 0) return -1; v = v * 16 + h; }
+        return v;
+    }
+    // The kernel prints addresses as host-order 32-bit words, so copying each
+    // word back in host order yields the network-order bytes.
+    static bool addr_port(const char*& p, bool v6, array<uint8_t, 16>& addr, uint16_t& port) {
+        addr.fill(0);
+        for (int w = 0; w < (v6 ? 4 : 1); ++w) {
+            long long v = hex(p, 8);
+            if (v < 0) return false;
+            uint32_t u = static_cast<uint32_t>(v);
+            memcpy(addr.data() + 4 * w, &u, 4);
+        }
+        if (*p++ != ':') return false;
+        long long pt = hex(p, 4);
+        if (pt < 0) return false;
+        port = static_cast<uint16_t>(pt);
+        return true;
+    }
+
+    void parse(const string& text, uint8_t proto) {
+        const bool v6 = proto & 1;
+        const char* p = text.c_str();
+        p = strchr(p, '\n');                   // header line
+        while (p && *++p) {
+            const char* eol = strchr(p, '\n');
+            SockEntry e{};
+            e.proto = proto;
+            const char* q = strchr(p, ':');     // after "sl:"
+            if (!q || (eol && q > eol)) break;
+            ++q;
+            while (*q == ' ') ++q;
+            bool ok = addr_port(q, v6, e.laddr, e.lport);
+            if (ok) { while (*q == ' ') ++q; ok = addr_port(q, v6, e.raddr, e.rport); }
+            long long st = -1;
+            if (ok) { while (*q == ' ') ++q; st = hex(q, 2); }
+            if (ok && st >= 0) {
+                // tx:rx tr:when retrnsmt uid timeout inode
+                e.state = static_cast<uint8_t>(st);
+                char* end = const_cast<char*>(q);
+                for (int f = 0; f < 5; ++f) { while (*end == ' ') ++end; while (*end && *end != ' ') ++end; }
+                e.inode = strtoull(end, &end, 10);
+                ents.push_back(e);
+            }
+            p = eol;
+        }
+    }
+
+    void load_owners() {
+        owners_loaded = true;
+#ifdef __linux__
+        DIR* proc = opendir("/proc");
+        if (!proc) return;
+        while (dirent* d = readdir(proc)) {
+            if (!isdigit(static_cast<unsigned char>(d->d_name[0]))) continue;
+            string base = string("/proc/") + d->d_name;
+            DIR* fds = opendir((base + "/fd").c_str());
+            if (!fds) continue;
+            string comm;
+            while (dirent* f = readdir(fds)) {
+                char link[64];
+                ssize_t n = readlink((base + "/fd/" + f->d_name).c_str(), link, sizeof link - 1);
+                if (n < 9 || memcmp(link, "socket:[", 8) != 0) continue;
+                link[n] = '\0';
+                uint64_t ino = strtoull(link + 8, nullptr, 10);
+                if (comm.empty()) {
+                    ifstream c(base + "/comm");
+                    getline(c, comm);
+                    comm = string(d->d_name) + "/" + (comm.empty() ? "?" : comm);
+                }
+                owners.emplace(ino, comm);
+            }
+            closedir(fds);
+        }
+        closedir(proc);
+#endif
+    }
+};
+
+#endif
+
+// -------- DNS client --------
+#if !OS_WIN
+// Minimal stub resolver over one connected UDP socket: many queries are kept
+// in flight (bounded by max_inflight), matched back by id and question, and
+// retried on timeout. Truncated answers are reported as-is (no TCP retry).
+struct DnsAnswer {
+    string name;
+    uint16_t type{0};
+    uint32_t ttl{0};
+    string data;            // presentation form: address, "pref host", host
+};
+
+struct DnsResult {
+    string domain;
+    uint16_t qtype{0};
+    int rcode{-1};          // -1: no answer (timeout or send failure)
+    bool truncated{false};
+    vector<DnsAnswer> answers;
+};
+
+class DnsClient {
+public:
+    enum : uint16_t { A = 1, NS = 2, CNAME = 5, SOA = 6, MX = 15, AAAA = 28 };
+
+    static const char* type_name(uint16_t t) {
+        switch (t) {
+        case A: return "A"; case NS: return "NS"; case CNAME: return "CNAME"; case SOA: return "SOA";
+        case MX: return "MX"; case AAAA: return "AAAA"; default: return "?";
+        }
+    }
+
+    // "host" or "host:port" (IPv6 as "[addr]:port"); empty means the first
+    // nameserver in /etc/resolv.conf. WDH_DNS overrides both.
+    explicit DnsClient(string server = "") {
+        if (const char* env = getenv("WDH_DNS")) server = env;
+        if (server.empty()) server = resolv_conf();
+        string host = server;
+        int port = 53;
+        if (!server.empty() && server[0] == '[') {
+            size_t e = server.find(']');
+            host = server.substr(1, e == string::npos ? string::npos : e - 1);
+            if (e != string::npos && e + 1 < server.size() && server[e + 1] == ':') port = atoi(server.c_str() + e + 2);
+        } else if (count(server.begin(), server.end(), ':') == 1) {
+            host = server.substr(0, server.find(':'));
+            port = atoi(server.c_str() + server.find(':') + 1);
+        }
+        sockaddr_storage ss{};
+        socklen_t len = 0;
+        auto* v4 = reinterpret_cast<sockaddr_in*>(&ss);
+        auto* v6 = reinterpret_cast<sockaddr_in6*>(&ss);
+        if (inet_pton(AF_INET, host.c_str(), &v4->sin_addr) == 1) {
+            v4->sin_family = AF_INET; v4->sin_port = htons(static_cast<uint16_t>(port)); len = sizeof *v4;
+        } else if (inet_pton(AF_INET6, host.c_str(), &v6->sin6_addr) == 1) {
+            v6->sin6_family = AF_INET6; v6->sin6_port = htons(static_cast<uint16_t>(port)); len = sizeof *v6;
+        } else return;
+        fd = socket(ss.ss_family, SOCK_DGRAM, 0);
+        if (fd < 0) return;
+        if (connect(fd, reinterpret_cast<sockaddr*>(&ss), len) != 0) { close(fd); fd = -1; return; }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        this->server = host + ":" + to_string(port);
+    }
+    ~DnsClient() { if (fd >= 0) close(fd); }
+    DnsClient(const DnsClient&) = delete;
+    DnsClient& operator=(const DnsClient&) = delete;
+
+    bool ok() const { return fd >= 0; }
+    const string& nameserver() const { return server; }
+
+    // Resolves every (name, type) pair; done() is called as each completes,
+    // in completion order. Each try waits timeout_ms before resending.
+    void resolve_all(const vector<pair<string, uint16_t>>& qs, size_t max_inflight,
+                     const function<void(DnsResult&&)>& done, int timeout_ms = 1500, int tries = 3) {
+        using clk = chrono::steady_clock;
+        struct Pending { size_t idx; int tries; clk::time_point deadline; };
+        unordered_map<uint16_t, Pending> inflight;
+        size_t next = 0;
+        if (max_inflight == 0) max_inflight = 1;
+        max_inflight = min<size_t>(max_inflight, 60000);
+        vector<uint8_t> pkt;
+        vector<uint8_t> buf(4096);
+
+        auto fail = [&](size_t idx) { DnsResult r; r.domain = qs[idx].first; r.qtype = qs[idx].second; done(move(r)); };
+        auto send_one = [&](size_t idx, int tries_left) {
+            uint16_t id;
+            do id = static_cast<uint16_t>(rng()); while (inflight.count(id));
+            if (!encode_query(id, qs[idx].first, qs[idx].second, pkt)) { fail(idx); return; }
+            send(fd, pkt.data(), pkt.size(), 0);   // a lost send is handled like a lost reply
+            inflight[id] = Pending{idx, tries_left, clk::now() + chrono::milliseconds(timeout_ms)};
+        };
+
+        while (next < qs.size() || !inflight.empty()) {
+            while (next < qs.size() && inflight.size() < max_inflight) send_one(next++, tries - 1);
+            if (inflight.empty()) continue;
+            pollfd p{fd, POLLIN, 0};
+            poll(&p, 1, 20);
+            for (;;) {
+                ssize_t n = recv(fd, buf.data(), buf.size(), 0);
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) break;
+                DnsResult r;
+                uint16_t id;
+                if (!decode(buf.data(), static_cast<size_t>(n), id, r)) continue;
+                auto it = inflight.find(id);
+                if (it == inflight.end()) continue;
+                const auto& q = qs[it->second.idx];
+                if (r.qtype != q.second || !same_name(r.domain, q.first)) continue;
+                r.domain = q.first;
+                inflight.erase(it);
+                done(move(r));
+            }
+            auto now = clk::now();
+            vector<uint16_t> expired;
+            for (auto& kv : inflight) if (kv.second.deadline <= now) expired.push_back(kv.first);
+            for (uint16_t id : expired) {
+                Pending pd = inflight[id];
+                inflight.erase(id);
+                if (pd.tries > 0) send_one(pd.idx, pd.tries - 1); else fail(pd.idx);
+            }
+        }
+    }
+
+    static bool encode_query(uint16_t id, const string& name, uint16_t type, vector<uint8_t>& out) {
+        out.assign({uint8_t(id >> 8), uint8_t(id), 0x01, 0x00, 0, 1, 0, 0, 0, 0, 0, 0});   // RD, one question
+        size_t start = 0;
+        while (start < name.size()) {
+            size_t dot = name.find('.', start);
+            if (dot == string::npos) dot = name.size();
+            size_t len = dot - start;
+            if (len == 0 || len > 63) return false;
+            out.push_back(static_cast<uint8_t>(len));
+            out.insert(out.end(), name.begin() + static_cast<ptrdiff_t>(start), name.begin() + static_cast<ptrdiff_t>(dot));
+            start = dot + 1;
+        }
+        if (out.size() > 12 + 254) return false;
+        out.insert(out.end(), {0, uint8_t(type >> 8), uint8_t(type), 0, 1});
+        return true;
+    }
+
+    // Parses a response: question (into r.domain/r.qtype), rcode, TC and the
+    // answer section. Returns false on anything malformed.
+    static bool decode(const uint8_t* m, size_t n, uint16_t& id, DnsResult& r) {
+        if (n < 12 || !(m[2] & 0x80)) return false;
+        id = uint16_t(m[0] << 8 | m[1]);
+        r.truncated = m[2] & 0x02;
+        r.rcode = m[3] & 0x0f;
+        unsigned qd = m[4] << 8 | m[5], an = m[6] << 8 | m[7];
+        size_t off = 12;
+        if (qd != 1 || !read_name(m, n, off, r.domain) || off + 4 > n) return false;
+        r.qtype = uint16_t(m[off] << 8 | m[off + 1]);
+        off += 4;
+        for (unsigned i = 0; i < an; ++i) {
+            DnsAnswer a;
+            if (!read_name(m, n, off, a.name) || off + 10 > n) return false;
+            a.type = uint16_t(m[off] << 8 | m[off + 1]);
+            a.ttl = uint32_t(m[off + 4]) << 24 | uint32_t(m[off + 5]) << 16 | uint32_t(m[off + 6]) << 8 | m[off + 7];
+            size_t rdlen = size_t(m[off + 8]) << 8 | m[off + 9];
+            off += 10;
+            if (off + rdlen > n) return false;
+            size_t rd = off;
+            char txt[INET6_ADDRSTRLEN] = "";
+            switch (a.type) {
+            case A:    if (rdlen == 4) { inet_ntop(AF_INET, m + rd, txt, sizeof txt); a.data = txt; } break;
+            case AAAA: if (rdlen == 16) { inet_ntop(AF_INET6, m + rd, txt, sizeof txt); a.data = txt; } break;
+            case NS: case CNAME: read_name(m, n, rd, a.data); break;
+            case MX:
+                if (rdlen >= 3) {
+                    string host;
+                    size_t h = rd + 2;
+                    read_name(m, n, h, host);
+                    a.data = to_string(m[rd] << 8 | m[rd + 1]) + " " + host;
+                }
+                break;
+            default: break;
+            }
+            off += rdlen;
+            r.answers.push_back(move(a));
+        }
+        return true;
+    }
+
+private:
+    int fd{-1};
+    string server;
+    mt19937 rng{random_device{}()};
+
+    static string resolv_conf() {
+        ifstream in("/etc/resolv.conf");
+        string line;
+        while (getline(in, line)) {
+            istringstream ls(line);
+            string key, val;
+            if (ls >> key >> val && key == "nameserver") return val;
+        }
+        return "127.0.0.1";
+    }
+
+    static bool same_name(const string& a, const string& b) {
+        string x = a, y = b;
+        if (!y.empty() && y.back() == '.') y.pop_back();
+        if (x.size() != y.size()) return false;
+        for (size_t i = 0; i < x.size(); ++i) if (ascii_lower(x[i]) != ascii_lower(y[i])) return false;
+        return true;
+    }
+
+    // Reads a possibly compressed name at off; off ends after the name as it
+    // appears in place. Pointer chains are capped to reject loops.
+    static bool read_name(const uint8_t* m, size_t n, size_t& off, string& out) {
+        out.clear();
+        size_t p = off;
+        bool jumped = false;
+        for (int hops = 0; hops < 64; ) {
+            if (p >= n) return false;
+            uint8_t len = m[p];
+            if (len == 0) { if (!jumped) off = p + 1; return true; }
+            if ((len & 0xc0) == 0xc0) {
+                if (p + 1 >= n) return false;
+                if (!jumped) off = p + 2;
+                p = size_t(len & 0x3f) << 8 | m[p + 1];
+                jumped = true;
+                ++hops;
+                continue;
+            }
+            if (len > 63 || p + 1 + len > n) return false;
+            if (!out.empty()) out += '.';
+            out.append(reinterpret_cast<const char*>(m + p + 1), len);
+            p += 1 + len;
+        }
+        return false;
+    }
+};
+
+// Answers cached by (name, type) in a fixed-size open-addressing table that
+// lives in a shared memory map, so the cache survives across runs and a
+// lookup touches one or two pages. Entries expire at the smallest answer
+// TTL; NXDOMAIN/NODATA use NEG_TTL. Slots are never emptied, only reused
+// once expired (or, when a probe run is full, the soonest-expiring slot).
+class DnsCache {
+public:
+    static constexpr uint32_t SLOTS = 1u << 16;
+    static constexpr int PROBES = 32;
+    static constexpr uint32_t NEG_TTL = 300;
+
+    explicit DnsCache(const string& path) {
+        fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) != 0) return;
+        size = sizeof(Header) + size_t(SLOTS) * sizeof(Slot);
+        bool fresh = static_cast<size_t>(st.st_size) != size;
+        if (fresh && ftruncate(fd, 0) != 0) return;      // wrong size: start over
+        if (fresh && ftruncate(fd, static_cast<off_t>(size)) != 0) return;
+        void* m = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (m == MAP_FAILED) return;
+        hdr = static_cast<Header*>(m);
+        slots = reinterpret_cast<Slot*>(hdr + 1);
+        if (fresh || memcmp(hdr->magic, "DNSC1\0\0\0", 8) != 0 || hdr->slots != SLOTS) {
+            if (!fresh) memset(m, 0, size);   // a new file is already zero (and sparse)
+            memcpy(hdr->magic, "DNSC1\0\0\0", 8);
+            hdr->slots = SLOTS;
+        }
+    }
+    ~DnsCache() {
+        if (hdr) munmap(hdr, size);
+        if (fd >= 0) close(fd);
+    }
+    DnsCache(const DnsCache&) = delete;
+    DnsCache& operator=(const DnsCache&) = delete;
+
+    bool ok() const { return hdr != nullptr; }
+    uint64_t hits() const { return run_hits; }
+    uint64_t misses() const { return run_misses; }
+    uint64_t total_hits() const { return hdr ? hdr->hits : 0; }
+    uint64_t total_misses() const { return hdr ? hdr->misses : 0; }
+
+    // On a hit, fills r with the cached answers, TTLs counted down to now.
+    bool lookup(const string& name, uint16_t qtype, DnsResult& r) {
+        if (!hdr) return false;
+        string lname = lower(name);
+        uint64_t key = hash(lname, qtype);
+        int64_t now = static_cast<int64_t>(time(nullptr));
+        for (int i = 0; i < PROBES; ++i) {
+            const Slot& s = slots[(key + i) & (SLOTS - 1)];
+            if (s.key == 0) break;
+            if (s.key != key || s.qtype != qtype || s.expires <= now) continue;
+            if (!unpack(s, lname, r)) continue;
+            for (auto& a : r.answers) a.ttl = static_cast<uint32_t>(s.expires - now);
+            ++run_hits; ++hdr->hits;
+            return true;
+        }
+        ++run_misses; ++hdr->misses;
+        return false;
+    }
+
+    // Caches NOERROR and NXDOMAIN answers; anything else (timeouts, SERVFAIL,
+    // truncated replies, answers too big for a slot) is skipped.
+    void store(const DnsResult& r) {
+        if (!hdr || r.truncated || (r.rcode != 0 && r.rcode != 3)) return;
+        string lname = lower(r.domain);
+        uint32_t ttl = UINT32_MAX;
+        for (auto& a : r.answers) if (!a.data.empty()) ttl = min(ttl, a.ttl);
+        if (ttl == UINT32_MAX) ttl = NEG_TTL;
+        if (ttl == 0) return;
+        Slot tmp{};
+        if (!pack(lname, r, tmp)) return;
+        uint64_t key = hash(lname, r.qtype);
+        int64_t now = static_cast<int64_t>(time(nullptr));
+        tmp.key = key;
+        tmp.qtype = r.qtype;
+        tmp.rcode = static_cast<int16_t>(r.rcode);
+        tmp.expires = now + ttl;
+        Slot* victim = nullptr;
+        for (int i = 0; i < PROBES; ++i) {
+            Slot& s = slots[(key + i) & (SLOTS - 1)];
+            bool same = s.key == key && s.qtype == r.qtype && s.payload[0] == lname.size()
+                        && memcmp(s.payload + 1, lname.data(), lname.size()) == 0;
+            if (s.key == 0 || same) { victim = &s; break; }
+            if (!victim || s.expires < victim->expires) victim = &s;
+        }
+        *victim = tmp;
+    }
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t slots, pad;
+        uint64_t hits, misses;
+        char reserved[32];
+    };
+    // payload: u8 len + lower-cased name, then per answer:
+    //   u16 type, u8 len + owner name, u8 len + data
+    struct Slot {
+        uint64_t key;           // 0 = never used
+        int64_t expires;        // unix seconds
+        uint16_t qtype;
+        int16_t rcode;
+        uint16_t answers, used;
+        uint8_t payload[488];
+    };
+    static_assert(sizeof(Slot) == 512, "slot layout");
+
+    Header* hdr{nullptr};
+    Slot* slots{nullptr};
+    size_t size{0};
+    int fd{-1};
+    uint64_t run_hits{0}, run_misses{0};
+
+    static string lower(string s) { for (char& c : s) c = ascii_lower(c); return s; }
+
+    static uint64_t hash(const string& name, uint16_t qtype) {
+        uint64_t h = 1469598103934665603ull;
+        for (unsigned char c : name) h = (h ^ c) * 1099511628211ull;
+        h = (h ^ qtype) * 1099511628211ull;
+        return h ? h : 1;
+    }
+
+    static bool pack(const string& lname, const DnsResult& r, Slot& s) {
+        size_t off = 0;
+        auto put_str = [&](const string& v) {
+            if (v.size() > 255 || off + 1 + v.size() > sizeof s.payload) return false;
+            s.payload[off++] = static_cast<uint8_t>(v.size());
+            memcpy(s.payload + off, v.data(), v.size());
+            off += v.size();
+            return true;
+        };
+        if (!put_str(lname)) return false;
+        for (auto& a : r.answers) {
+            if (a.data.empty()) continue;
+            if (off + 2 > sizeof s.payload) return false;
+            s.payload[off++] = uint8_t(a.type >> 8);
+            s.payload[off++] = uint8_t(a.type);
+            if (!put_str(a.name) || !put_str(a.data)) return false;
+            ++s.answers;
+        }
+        s.used = static_cast<uint16_t>(off);
+        return true;
+    }
+
+    static bool unpack(const Slot& s, const string& lname, DnsResult& r) {
+        size_t off = 0, end = min<size_t>(s.used, sizeof s.payload);
+        auto get_str = [&](string& v) {
+            if (off >= end || off + 1 + s.payload[off] > end) return false;
+            v.assign(reinterpret_cast<const char*>(s.payload + off + 1), s.payload[off]);
+            off += 1 + s.payload[off];
+            return true;
+        };
+        string name;
+        if (!get_str(name) || name != lname) return false;
+        r.qtype = s.qtype;
+        r.rcode = s.rcode;
+        r.truncated = false;
+        r.answers.clear();
+        for (unsigned i = 0; i < s.answers; ++i) {
+            DnsAnswer a;
+            if (off + 2 > end) return false;
+            a.type = uint16_t(s.payload[off] << 8 | s.payload[off + 1]);
+            off += 2;
+            if (!get_str(a.name) || !get_str(a.data)) return false;
+            r.answers.push_back(move(a));
+        }
+        return true;
+    }
+};
+
+#endif
+
 // -------- Console Tool class --------
 class Tool {
 public:
@@ -94,7 +2097,9 @@ private:
     static int run_system(const string& cmd);
     static int getInt(const string& prompt);
     static string getStr(const string& prompt);
-    static bool safe_eval(const string& e, double& out);
+    static double getDouble(const string& prompt);
+    static const Program& compiled(const string& e);
+    static bool safe_eval(const string& e, double& out, const vector<double>& vars = {});
 
     // commands
     void mdir();
@@ -102,14 +2107,26 @@ private:
     void write_file();
     void append_file();
     void sfile();
+    void sfile_dir(const string& root, const Query& query);
+    void sbench();
+    void sindex();
+    static bool load_patterns(const string& path, unique_ptr<Query>& query);
+    static void print_hits(const Query& query, const vector<size_t>& hits);
     void mkpasswd();
+    void mkpasswd_bulk();
     void guess();
     void calc();
+    void calcbench();
+    void calc_batch();
+    void simdbench();
+    void lexbench();
     void local_info();
     void osi();
     void ohd();
     void wdh();
+    void wdh_batch(const string& list, bool to_disk, const string& file);
     void pchk();
+    void pwatch();
 
     void print_help();
     const vector<string> CMDS = {
@@ -118,36 +2135,33 @@ private:
         "read: opens and reads a file.",
         "write: writes to a file.",
         "append: appends to a file.",
-        "sfile: search a file.",
+        "sfile: search a file or directory (a blank search string asks for a file of patterns, one per line).",
+        "sindex: builds or refreshes the trigram index sfile uses for a file.",
+        "sbench: benchmarks a pattern list in one pass vs one pass per pattern.",
         "mkpasswd: makes a random password.",
+        "mkpasswdb: makes passwords in bulk (length, count, classes, threads).",
         "guess: runs a guessing game.",
         "calc: a simple calculator.",
+        "calcb: evaluates a formula over the columns of a CSV file.",
+        "calcbench: benchmarks parse-every-time vs compile-once evaluation.",
+        "simdbench: benchmarks the batch operator kernels (GFLOP/s).",
+        "lexbench: benchmarks number lexing over a file of expressions.",
         "local: prints local system information.",
         "osi: displays OSI model info.",
         "ohd: displays ASCII conversions.",
         "wdh: whois/dig/host lookups.",
         "pchk: checks services on a port.",
+        "pwatch: watches sockets and prints listener and connection changes.",
         "exit: exit the console."
     };
 };
 
 // -------- Tool method definitions --------
+// stdout is returned; stderr is passed through to the console as before.
 string Tool::run_capture(const string& cmd) {
-    string data;
-#if OS_WIN
-    FILE* fp = _popen(cmd.c_str(), "r");
-#else
-    FILE* fp = popen(cmd.c_str(), "r");
-#endif
-    if (!fp) return data;
-    char buf[1024];
-    while (fgets(buf, sizeof(buf), fp)) data += buf;
-#if OS_WIN
-    _pclose(fp);
-#else
-    pclose(fp);
-#endif
-    return data;
+    ProcResult r = move(ProcessRunner::run_all({cmd})[0]);
+    cerr << r.err;
+    return r.out;
 }
 
 int Tool::run_system(const string& cmd) {
@@ -168,11 +2182,28 @@ string Tool::getStr(const string& prompt) {
     return s;
 }
 
-bool Tool::safe_eval(const string& e, double& out) {
+double Tool::getDouble(const string& prompt) {
+    cout << prompt;
+    string s; getline(cin, s);
+    try { return stod(s); } catch (...) { return 0.0; }
+}
+
+// Compiled programs are cached by expression text so repeated formulas skip
+// the parser entirely; the cache is simply dropped once it grows too large.
+const Program& Tool::compiled(const string& e) {
+    static unordered_map<string, Program> cache;
+    auto it = cache.find(e);
+    if (it != cache.end()) return it->second;
+    Program p = Parser(e).compile();
+    if (cache.size() >= 4096) cache.clear();
+    return cache.emplace(e, move(p)).first->second;
+}
+
+bool Tool::safe_eval(const string& e, double& out, const vector<double>& vars) {
     try {
-        Parser p(e);
-        out = p.expr();
-        if (!p.finished()) throw runtime_error("trailing characters");
+        const Program& p = compiled(e);
+        if (vars.size() < p.variables().size()) throw runtime_error("unbound variable '" + p.variables()[vars.size()] + "'");
+        out = p.evaluate(vars.data());
         return true;
     } catch (const exception& ex) {
         cerr << "Error: " << ex.what() << "\n";
@@ -198,10 +2229,28 @@ void Tool::mdir() {
 }
 
 void Tool::read_file() {
+    static unordered_map<string, LineIndex> line_indexes;
     string fname = getStr("Filename:\n> ");
-    ifstream in(fname);
-    if (!in) { cout << "File not found!\n"; return; }
-    cout << in.rdbuf();
+    MappedFile f(fname);
+    if (!f.ok()) { cout << "File not found!\n"; return; }
+    string mode = getStr("Mode: all | head N | tail N | bytes A-B | lines A-B (default all): ");
+    istringstream ms(mode);
+    string kind; ms >> kind;
+    unsigned long long a = 0, b = 0;
+    char dash = 0;
+    if (kind == "head" || kind == "tail") ms >> a;
+    else if (kind == "bytes" || kind == "lines") { ms >> a >> dash >> b; if (dash != '-' || b < a) { cout << "Expected a range like 10-20.\n"; return; } }
+
+    if (kind.empty() || kind == "all") write_range(f, 0, f.size());
+    else if (kind == "head")  write_range(f, 0, line_indexes[fname].line_start(f, a));
+    else if (kind == "tail")  { uint64_t s = tail_start(f, a); write_range(f, s, f.size() - s); }
+    else if (kind == "bytes") write_range(f, a, b - a + 1);              // inclusive, 0-based
+    else if (kind == "lines") {                                          // inclusive, 1-based
+        LineIndex& li = line_indexes[fname];
+        uint64_t s = li.line_start(f, a ? a - 1 : 0), e = li.line_start(f, b);
+        write_range(f, s, e - s);
+    }
+    else cout << "Unknown mode.\n";
 }
 
 void Tool::write_file() {
@@ -221,38 +2270,256 @@ void Tool::append_file() {
     cout << "Written to file...\n";
 }
 
+// One pattern per non-empty line of path.
+bool Tool::load_patterns(const string& path, unique_ptr<Query>& query) {
+    ifstream in(path);
+    if (!in) { cout << "Pattern file not found!\n"; return false; }
+    vector<string> pats;
+    string line;
+    while (getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty()) pats.push_back(line);
+    }
+    query = make_unique<Query>(pats);
+    return true;
+}
+
+void Tool::print_hits(const Query& query, const vector<size_t>& hits) {
+    if (!query.multi()) return;
+    cout << "Pattern hits:\n";
+    for (size_t i = 0; i < query.patterns(); ++i) cout << setw(10) << hits[i] << "  " << query.pattern(i) << "\n";
+}
+
 void Tool::sfile() {
+    string fn = getStr("Filename or directory: ");
+    string s  = getStr("Search String (blank to use a pattern file): ");
+    unique_ptr<Query> query;
+    if (!s.empty()) query = make_unique<Query>(s);
+    else if (!load_patterns(getStr("Pattern file: "), query)) return;
+#if __has_include(<filesystem>)
+    error_code ec;
+    if (fs::is_directory(fn, ec)) { sfile_dir(fn, *query); return; }
+#endif
+    MappedFile f(fn);
+    if (!f.ok()) { cout << "File not found!\n"; return; }
+    LineWriter out(cout);
+    vector<size_t> hits(query->patterns(), 0);
+    size_t n = 0;
+    TrigramIndex idx(fn, f);
+    vector<string> pats = query->pattern_list();
+    if (idx.ok() && TrigramIndex::usable(pats)) {
+        size_t scanned = idx.candidates(pats, [&](uint64_t off, uint64_t len) {
+            n += query->grep(f.data() + off, f.data() + off + len, out, hits);
+        });
+        n += query->grep(f.data() + idx.indexed(), f.data() + f.size(), out, hits);
+        out.flush();
+        cerr << "[index] scanned " << scanned << " of " << idx.blocks() << " blocks + "
+             << f.size() - idx.indexed() << " unindexed bytes\n";
+    } else {
+        n = query->grep(f.data(), f.data() + f.size(), out, hits);
+    }
+    out.flush();
+    if (!n) cout << "No matches found.\n";
+    print_hits(*query, hits);
+}
+
+void Tool::sindex() {
     string fn = getStr("Filename: ");
-    string s  = getStr("Search String: ");
-#if OS_WIN
-    string cmd = string("findstr /I /C:\"") + s + "\" \"" + fn + "\"";
+    MappedFile f(fn);
+    if (!f.ok()) { cout << "File not found!\n"; return; }
+    uint64_t reused = 0, added = 0;
+    string err;
+    auto t0 = chrono::steady_clock::now();
+    if (!TrigramIndex::refresh(fn, f, reused, added, err)) { cerr << "[ERROR] sindex: " << err << "\n"; return; }
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    cout << "Index " << TrigramIndex::path_for(fn) << ": " << reused + added << " blocks (" << reused << " kept, "
+         << added << " built) in " << fixed << setprecision(1) << secs * 1e3 << " ms\n" << defaultfloat;
+}
+
+// Times one Aho-Corasick pass over the file against one single-needle pass
+// per pattern (the old way to look for a list), with output discarded.
+void Tool::sbench() {
+    string fn = getStr("Filename: ");
+    string pf = getStr("Pattern file: ");
+    unique_ptr<Query> query;
+    if (!load_patterns(pf, query)) return;
+    MappedFile f(fn);
+    if (!f.ok()) { cout << "File not found!\n"; return; }
+    if (!query->patterns()) { cout << "No patterns.\n"; return; }
+    const double mb = static_cast<double>(f.size()) / (1024.0 * 1024.0);
+    using clk = chrono::steady_clock;
+
+    LineWriter sink = LineWriter::discard();
+    vector<size_t> hits(query->patterns(), 0);
+    auto t0 = clk::now();
+    size_t ac_lines = query->grep(f.data(), f.data() + f.size(), sink, hits);
+    double ac = chrono::duration<double>(clk::now() - t0).count();
+
+    size_t single_lines = 0;
+    t0 = clk::now();
+    for (size_t i = 0; i < query->patterns(); ++i) {
+        Needle nd(query->pattern(i));
+        single_lines += grep_buffer(f.data(), f.data() + f.size(), nd, sink);
+    }
+    double single = chrono::duration<double>(clk::now() - t0).count();
+
+    cout << fixed << setprecision(1)
+         << "File:                  " << fn << " (" << mb << " MB), " << query->patterns() << " patterns\n"
+         << "Aho-Corasick, 1 pass:  " << ac * 1e3 << " ms, " << mb / ac << " MB/s (" << ac_lines << " lines)\n"
+         << "Needle, 1 pass each:   " << single * 1e3 << " ms, " << mb / single << " MB/s effective, "
+         << mb * static_cast<double>(query->patterns()) / single << " MB/s per pass (" << single_lines << " line hits)\n"
+         << "Speedup:               " << single / ac << "x\n" << defaultfloat;
+}
+
+// Recursive search: the tree is walked once to list the files, then each
+// file is searched on the work-stealing pool into its own buffer. The
+// calling thread prints the buffers strictly in walk order as they complete,
+// so output is grouped per file and stable from run to run.
+void Tool::sfile_dir(const string& root, const Query& query) {
+#if __has_include(<filesystem>)
+    int threads = getInt("Threads (0 = one per core): ");
+    vector<string> include = split_list(getStr("Include globs, comma separated (blank = all): "));
+    vector<string> exclude = split_list(getStr("Exclude globs, comma separated (blank = none): "));
+    if (threads <= 0) threads = static_cast<int>(max(1u, thread::hardware_concurrency()));
+
+    vector<string> files;
+    error_code ec;
+    for (fs::recursive_directory_iterator it(root, fs::directory_options::skip_permission_denied, ec), end; !ec && it != end; it.increment(ec)) {
+        error_code fec;
+        if (!it->is_regular_file(fec)) continue;
+        string rel = it->path().lexically_relative(root).generic_string();
+        string name = it->path().filename().string();
+        if (!include.empty() && !glob_any(include, rel, name)) continue;
+        if (glob_any(exclude, rel, name)) continue;
+        files.push_back(it->path().string());
+    }
+    if (ec) cerr << "[ERROR] walking " << root << ": " << ec.message() << "\n";
+
+    vector<string> results(files.size());
+    vector<size_t> counts(files.size(), 0);
+    vector<char> done(files.size(), 0);
+    vector<size_t> hits(query.patterns(), 0);
+    mutex m;
+    condition_variable cv;
+    WorkStealingPool pool(static_cast<size_t>(threads), files.size(), [&](size_t i) {
+        MappedFile f(files[i]);
+        LineWriter w(nullptr, files[i] + ":");
+        vector<size_t> local(query.patterns(), 0);
+        size_t n = f.ok() ? query.grep(f.data(), f.data() + f.size(), w, local) : 0;
+        string text = w.take();
+        lock_guard<mutex> lock(m);
+        for (size_t k = 0; k < local.size(); ++k) hits[k] += local[k];
+        results[i].swap(text);
+        counts[i] = n;
+        done[i] = 1;
+        cv.notify_one();
+    });
+
+    size_t total = 0, with_hits = 0;
+    for (size_t i = 0; i < files.size(); ++i) {
+        string text;
+        {
+            unique_lock<mutex> lock(m);
+            cv.wait(lock, [&] { return done[i] != 0; });
+            text.swap(results[i]);
+        }
+        cout.write(text.data(), static_cast<streamsize>(text.size()));
+        total += counts[i];
+        if (counts[i]) ++with_hits;
+    }
+    pool.wait();
+    if (!total) cout << "No matches found.\n";
+    cout << total << " matching lines in " << with_hits << " of " << files.size() << " files (" << threads << " threads)\n";
+    print_hits(query, hits);
 #else
-    string cmd = string("grep -i -- \"") + s + "\" \"" + fn + "\"";
+    (void)root; (void)query;
+    cout << "Directory search needs <filesystem>.\n";
 #endif
-    string out = run_capture(cmd);
-    if (out.empty()) cout << "No matches found.\n"; else cout << out;
 }
 
 void Tool::mkpasswd() {
     const string letters = "abcdefghijklmnopqrstuvwxyz";
     const string numbs   = "0123456789";
     const string special = "!^*£$";
-    random_device rd; mt19937 gen(rd());
-    uniform_int_distribution<> dLet(0, static_cast<int>(letters.size()) - 1);
-    uniform_int_distribution<> dNum(0, static_cast<int>(numbs.size()) - 1);
-    uniform_int_distribution<> dSp(0, static_cast<int>(special.size()) - 1);
-    uniform_int_distribution<> pick(0, 2);
+    static ChaCha20 gen = ChaCha20::make();
+    const unsigned nLet = static_cast<unsigned>(letters.size());
+    const unsigned nNum = static_cast<unsigned>(numbs.size());
+    const unsigned nSp = static_cast<unsigned>(special.size());
     string pass; pass.reserve(8);
-    pass += letters[dLet(gen)];
+    pass += letters[gen.below(nLet)];
     for (int i = 1; i < 8; i++) {
-        int sel = pick(gen);
-        if (sel == 0) pass += letters[dLet(gen)];
-        else if (sel == 1) pass += numbs[dNum(gen)];
-        else pass += special[dSp(gen)];
+        unsigned sel = gen.below(3);
+        if (sel == 0) pass += letters[gen.below(nLet)];
+        else if (sel == 1) pass += numbs[gen.below(nNum)];
+        else pass += special[gen.below(nSp)];
     }
     cout << "Password is: " << pass << "\nLength: " << pass.size() << "\n";
 }
 
+// Bulk mode: count passwords of one length drawn uniformly from the chosen
+// classes. Work is done in rounds of up to ROUND passwords into one reused
+// buffer; each thread fills its own slice with its own ChaCha20 stream, and
+// a round goes out in a single write.
+void Tool::mkpasswd_bulk() {
+    const size_t ROUND = 1 << 20;
+    int len = getInt("Length (default 16): ");
+    if (len <= 0) len = 16;
+    long long count = 0;
+    try { count = stoll(getStr("Count (default 1): ")); } catch (...) {}
+    if (count <= 0) count = 1;
+    string cls = getStr("Classes: l=lower u=upper d=digits s=special (default luds): ");
+    if (cls.empty()) cls = "luds";
+    string alphabet;
+    if (cls.find('l') != string::npos) alphabet += "abcdefghijklmnopqrstuvwxyz";
+    if (cls.find('u') != string::npos) alphabet += "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    if (cls.find('d') != string::npos) alphabet += "0123456789";
+    if (cls.find('s') != string::npos) alphabet += "!^*$%&#@-_=+";
+    if (alphabet.empty()) { cout << "No character classes selected.\n"; return; }
+    int threads = getInt("Threads (default 1): ");
+    if (threads <= 0) threads = 1;
+    string fname = getStr("Output file (blank = screen): ");
+
+    ofstream file;
+    if (!fname.empty()) {
+        file.open(fname, ios::binary);
+        if (!file) { cout << "Could not open file.\n"; return; }
+    }
+    ostream& out = fname.empty() ? cout : static_cast<ostream&>(file);
+
+    const size_t stride = static_cast<size_t>(len) + 1;
+    const unsigned n = static_cast<unsigned>(alphabet.size());
+    const size_t per_round = min<size_t>(static_cast<size_t>(count), ROUND);
+    vector<char> buf(per_round * stride);
+    vector<ChaCha20> engines;
+    for (int t = 0; t < threads; ++t) engines.push_back(ChaCha20::make());
+
+    auto t0 = chrono::steady_clock::now();
+    for (size_t done = 0; done < static_cast<size_t>(count);) {
+        size_t m = min(per_round, static_cast<size_t>(count) - done);
+        size_t slice = (m + threads - 1) / threads;
+        auto fill = [&](int t) {
+            ChaCha20& g = engines[t];
+            size_t lo = t * slice, hi = min(m, lo + slice);
+            for (size_t i = lo; i < hi; ++i) {
+                char* p = buf.data() + i * stride;
+                for (int k = 0; k < len; ++k) p[k] = alphabet[g.below(n)];
+                p[len] = '\n';
+            }
+        };
+        vector<thread> pool;
+        for (int t = 1; t < threads; ++t) pool.emplace_back(fill, t);
+        fill(0);
+        for (auto& th : pool) th.join();
+        out.write(buf.data(), static_cast<streamsize>(m * stride));
+        done += m;
+    }
+    out.flush();
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    if (!fname.empty())
+        cout << count << " passwords written to " << fname << " in " << fixed << setprecision(2) << secs << "s ("
+             << setprecision(0) << count / max(secs, 1e-9) << "/s)\n" << defaultfloat;
+}
+
 void Tool::guess() {
     cout << "Ok... guessing game, 5 difficulty levels\n";
     array<array<int, 2>, 5> r{{{0,2},{0,4},{0,5},{0,6},{0,9}}};
@@ -267,21 +2534,235 @@ void Tool::guess() {
 void Tool::calc() {
     string e = getStr("Please type a sum, e.g. '1+2*3': ");
     double v = 0.0;
-    if (safe_eval(e, v)) cout << "= " << setprecision(15) << v << "\n";
+    vector<double> vars;
+    try {
+        for (const string& name : compiled(e).variables()) vars.push_back(getDouble(name + " = "));
+    } catch (const exception&) { /* reported by safe_eval below */ }
+    if (safe_eval(e, v, vars)) cout << "= " << setprecision(15) << v << "\n";
     else cout << "Error: evaluation failed.\n";
 }
 
+// Reads a CSV with a header row, evaluates the formula over whole columns in
+// one batch call and writes the result column to another file.
+void Tool::calc_batch() {
+    string e     = getStr("Formula, e.g. 'cpu*100/cores': ");
+    string input = getStr("Input CSV (first line holds column names): ");
+    string dest  = getStr("Output file: ");
+    Program prog;
+    try { prog = Parser(e).compile(); }
+    catch (const exception& ex) { cerr << "Error: " << ex.what() << "\n"; return; }
+
+    ifstream in(input);
+    if (!in) { cout << "File not found!\n"; return; }
+    string line;
+    getline(in, line);
+    vector<string> header;
+    { istringstream hs(line); string h; while (getline(hs, h, ',')) header.push_back(h); }
+    for (auto& h : header) { while (!h.empty() && isspace(static_cast<unsigned char>(h.back()))) h.pop_back(); while (!h.empty() && isspace(static_cast<unsigned char>(h.front()))) h.erase(0, 1); }
+
+    unordered_map<string, vector<double>> cols;
+    vector<vector<double>*> slot(header.size(), nullptr);
+    for (const string& name : prog.variables()) {
+        size_t n = 0;
+        while (n < header.size() && header[n] != name) ++n;
+        if (n == header.size()) { cerr << "Error: no column named '" << name << "'\n"; return; }
+        slot[n] = &cols[name];
+    }
+    size_t rows = 0;
+    while (getline(in, line)) {
+        if (line.empty()) continue;
+        const char* p = line.c_str();
+        for (size_t n = 0; n < header.size(); ++n) {
+            char* end = nullptr;
+            double v = strtod(p, &end);
+            if (slot[n]) slot[n]->push_back(end == p ? 0.0 : v);
+            const char* comma = strchr(end, ',');
+            if (!comma) { for (size_t m = n + 1; m < header.size(); ++m) if (slot[m]) slot[m]->push_back(0.0); break; }
+            p = comma + 1;
+        }
+        ++rows;
+    }
+
+    vector<double> result(rows);
+    auto t0 = chrono::steady_clock::now();
+    try { prog.evaluate_batch(cols, result); }
+    catch (const exception& ex) { cerr << "Error: " << ex.what() << "\n"; return; }
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    ofstream out(dest);
+    if (!out) { cout << "Could not open output file.\n"; return; }
+    out << "result\n" << setprecision(15);
+    for (double v : result) out << v << "\n";
+    cout << "Evaluated " << rows << " rows in " << secs * 1e3 << " ms, written to " << dest << "\n";
+}
+
+void Tool::calcbench() {
+    string e = getStr("Expression to benchmark (default '(1+2*3-4/5)^2%7+(8-9)*10'): ");
+    if (e.empty()) e = "(1+2*3-4/5)^2%7+(8-9)*10";
+    const int N = 1000000;
+    Program prog;
+    try { prog = Parser(e).compile(); }
+    catch (const exception& ex) { cerr << "Error: " << ex.what() << "\n"; return; }
+    if (!prog.variables().empty()) { cerr << "Error: calcbench needs an expression without variables\n"; return; }
+
+    using clk = chrono::steady_clock;
+    double sink = 0.0;
+    auto t0 = clk::now();
+    for (int n = 0; n < N; ++n) { Parser p(e); sink += p.expr(); }
+    auto t1 = clk::now();
+    for (int n = 0; n < N; ++n) sink += prog.evaluate();
+    auto t2 = clk::now();
+
+    double parse = chrono::duration<double>(t1 - t0).count();
+    double comp  = chrono::duration<double>(t2 - t1).count();
+    cout << fixed << setprecision(3)
+         << "Evaluations:        " << N << " (" << prog.size() << " instructions)\n"
+         << "Parse every time:   " << parse << " s (" << parse * 1e9 / N << " ns/eval)\n"
+         << "Compile once:       " << comp  << " s (" << comp  * 1e9 / N << " ns/eval)\n"
+         << "Speedup:            " << parse / comp << "x\n"
+         << defaultfloat << "(checksum " << sink << ")\n";
+}
+
+// Times each batch operator kernel on cache-resident columns and reports
+// GFLOP/s (one operation per element) for the scalar set and the set picked
+// by CPU feature detection.
+void Tool::simdbench() {
+    const size_t N = 4096;
+    const int reps = 4000;
+    mt19937_64 gen(42);
+    uniform_real_distribution<> unit(0.5, 2.0), big(0.0, 1e6), small(1.0, 1000.0);
+    uniform_int_distribution<> iexp(0, 8);
+    vector<double> a(N), b(N), bint(N), abig(N), bsmall(N), w(N);
+    for (size_t r = 0; r < N; ++r) {
+        a[r] = unit(gen); b[r] = unit(gen); bint[r] = iexp(gen);
+        abig[r] = big(gen); bsmall[r] = small(gen);
+    }
+    struct Case { const char* name; Kernel Kernels::*k; const vector<double>* x; const vector<double>* y; };
+    const Case cases[] = {
+        { "+", &Kernels::add, &a, &b }, { "-", &Kernels::sub, &a, &b },
+        { "*", &Kernels::mul, &a, &b }, { "/", &Kernels::div, &a, &b },
+        { "^ (int exp)", &Kernels::pow, &a, &bint }, { "^ (real exp)", &Kernels::pow, &a, &b },
+        { "%", &Kernels::mod, &abig, &bsmall },
+    };
+    auto gflops = [&](Kernel k, const vector<double>& x, const vector<double>& y) {
+        auto t0 = chrono::steady_clock::now();
+        for (int n = 0; n < reps; ++n) k(w.data(), x.data(), y.data(), N);
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        return static_cast<double>(N) * reps / secs / 1e9;
+    };
+    const Kernels& best = kernels();
+    cout << "Kernel set: " << best.name << "\n"
+         << left << setw(14) << "op" << setw(12) << "scalar" << setw(12) << best.name << "speedup\n";
+    double check = 0.0;
+    for (const Case& c : cases) {
+        double s = gflops(SCALAR_KERNELS.*c.k, *c.x, *c.y);
+        check += w[N / 2];
+        double v = gflops(best.*c.k, *c.x, *c.y);
+        check += w[N / 2];
+        cout << setw(14) << c.name << fixed << setprecision(3) << setw(12) << s << setw(12) << v << v / s << "x\n" << defaultfloat;
+    }
+    cout << right << "(GFLOP/s; checksum " << check << ")\n";
+}
+
+// Lexes every literal of an expression file twice: the old substr+stod way
+// and lex_number straight from the buffer. A blank filename generates a
+// 100 MB file of random expressions first.
+void Tool::lexbench() {
+    string fname = getStr("Expression file (blank = generate 100 MB calc_lexbench.txt): ");
+    if (fname.empty()) {
+        fname = "calc_lexbench.txt";
+        ofstream gen(fname, ios::binary);
+        if (!gen) { cout << "Could not open output file.\n"; return; }
+        mt19937_64 g(7);
+        const char ops[] = "+-*/^%";
+        string line;
+        char num[32];
+        for (size_t written = 0; written < 100u * 1024 * 1024; written += line.size()) {
+            line.clear();
+            for (int t = 0; t < 8; ++t) {
+                if (t) line += ops[g() % 6];
+                snprintf(num, sizeof(num), g() % 2 ? "%llu.%llu" : "%llu", static_cast<unsigned long long>(g() % 100000), static_cast<unsigned long long>(g() % 10000));
+                line += num;
+            }
+            line += '\n';
+            gen << line;
+        }
+    }
+    ifstream in(fname, ios::binary);
+    if (!in) { cout << "File not found!\n"; return; }
+    string buf((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    auto is_num = [](char c) { return (c >= '0' && c <= '9') || c == '.'; };
+
+    using clk = chrono::steady_clock;
+    double old_sum = 0.0, new_sum = 0.0;
+    size_t literals = 0;
+    auto t0 = clk::now();
+    for (size_t i = 0; i < buf.size();) {
+        if (!is_num(buf[i])) { ++i; continue; }
+        size_t j = i;
+        while (i < buf.size() && is_num(buf[i])) ++i;
+        try { old_sum += stod(buf.substr(j, i - j)); } catch (...) {}
+        ++literals;
+    }
+    auto t1 = clk::now();
+    const char* p = buf.data();
+    const char* end = p + buf.size();
+    while (p < end) {
+        if (!is_num(*p)) { ++p; continue; }
+        double v = 0.0;
+        const char* q = lex_number(p, end, v);
+        if (!q) { ++p; continue; }
+        new_sum += v;
+        p = q;
+    }
+    auto t2 = clk::now();
+
+    double before = chrono::duration<double>(t1 - t0).count();
+    double after  = chrono::duration<double>(t2 - t1).count();
+    cout << fixed << setprecision(2)
+         << "File:               " << fname << " (" << buf.size() / (1024.0 * 1024.0) << " MB, " << literals << " literals)\n"
+         << "substr + stod:      " << before * 1e9 / literals << " ns/literal\n"
+         << "lex_number:         " << after * 1e9 / literals << " ns/literal\n"
+         << "Speedup:            " << before / after << "x\n"
+         << defaultfloat << "(checksums " << old_sum << " / " << new_sum << ")\n";
+}
+
+// Collectors run concurrently, each bounded by LOCAL_TIMEOUT_MS, so the whole
+// report takes about as long as the slowest one.
 void Tool::local_info() {
-    string fname = "local_system_information.txt";
-    ofstream out(fname);
+    const int LOCAL_TIMEOUT_MS = 10000;
+    string fmt = getStr("Format: txt | json | bin (default txt): ");
+    if (fmt.empty()) fmt = "txt";
+    if (fmt != "txt" && fmt != "json" && fmt != "bin") { cout << "Unknown format.\n"; return; }
+    string fname = "local_system_information." + fmt;
+    ofstream out(fname, fmt == "bin" ? ios::binary : ios::out);
     if (!out) { cout << "Could not open output file.\n"; return; }
 #if OS_WIN
     vector<string> cmds = { "whoami", "tasklist", "netstat -ano" };
 #else
     vector<string> cmds = { "w -i -p", "who -a", "service --status-all", "netstat -tuln" };
 #endif
-    for (auto& c : cmds) out << run_capture(c);
-    cout << "System info written to " << fname << "\n";
+    auto t0 = chrono::steady_clock::now();
+    vector<ProcResult> res = ProcessRunner::run_all(cmds, LOCAL_TIMEOUT_MS);
+    double total = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    vector<Section> secs;
+    for (auto& r : res) {
+        Section s;
+        s.name = r.cmd.substr(0, r.cmd.find(' '));
+        s.res = move(r);
+        secs.push_back(move(s));
+    }
+    if (fmt == "txt") {
+        for (auto& s : secs) { out << s.res.out; cerr << s.res.err; }
+    } else if (fmt == "json") {
+        write_sections_json(out, secs, total);
+    } else {
+        write_sections_bin(out, secs);
+    }
+    for (auto& s : secs)
+        if (s.res.timed_out) cout << s.name << " timed out after " << LOCAL_TIMEOUT_MS / 1000 << "s\n";
+    cout << "System info written to " << fname << " (" << fixed << setprecision(2) << total << "s)\n" << defaultfloat;
 }
 
 void Tool::osi() {
@@ -303,11 +2784,14 @@ void Tool::ohd() {
 #endif
 }
 
+// '@file' switches to batch mode: every domain in the file is resolved for
+// A/AAAA/MX/NS in process, with results printed as they arrive.
 void Tool::wdh() {
-    string domain = getStr("Domain name please (e.g google.com):\n$: ");
+    string domain = getStr("Domain name please (e.g google.com, @file for a list):\n$: ");
     string save   = getStr("Save to disk? (y/n): ");
     string file   = getStr("Please pick a filename: ");
     bool to_disk = (!save.empty() && (save[0] == 'y' || save[0] == 'Y'));
+    if (domain.size() > 1 && domain[0] == '@') { wdh_batch(domain.substr(1), to_disk, file); return; }
 
 #if OS_WIN
     string c1 = "whois " + domain;
@@ -318,35 +2802,177 @@ void Tool::wdh() {
     string c2 = "dig "   + domain;
     string c3 = "host "  + domain;
 #endif
+    ofstream out;
     if (to_disk) {
-        ofstream out(file);
+        out.open(file);
         if (!out) { cout << "Could not open file.\n"; return; }
-        out << run_capture(c1);
-        out << run_capture(c2);
-        out << run_capture(c3);
-        cout << "Results saved to " << file << "\n";
-    } else {
-        cout << run_capture(c1);
-        cout << run_capture(c2);
-        cout << run_capture(c3);
     }
+    ostream& dst = to_disk ? static_cast<ostream&>(out) : cout;
+    for (auto& r : ProcessRunner::run_all({c1, c2, c3})) { dst << r.out; cerr << r.err; }
+    if (to_disk) cout << "Results saved to " << file << "\n";
+}
+
+void Tool::wdh_batch(const string& list, bool to_disk, const string& file) {
+#if OS_WIN
+    (void)list; (void)to_disk; (void)file;
+    cout << "Batch lookups need POSIX sockets.\n";
+#else
+    ifstream in(list);
+    if (!in) { cout << "Domain list not found!\n"; return; }
+    vector<pair<string, uint16_t>> qs;
+    string line;
+    while (getline(in, line)) {
+        size_t a = line.find_first_not_of(" \t\r"), b = line.find_last_not_of(" \t\r");
+        if (a == string::npos || line[a] == '#') continue;
+        string d = line.substr(a, b - a + 1);
+        if (d.back() == '.') d.pop_back();
+        for (uint16_t t : {DnsClient::A, DnsClient::AAAA, DnsClient::MX, DnsClient::NS}) qs.push_back({d, t});
+    }
+    int cap = getInt("Queries in flight (default 256): ");
+    DnsClient dns;
+    ofstream out;
+    if (to_disk) {
+        out.open(file);
+        if (!out) { cout << "Could not open file.\n"; return; }
+    }
+    ostream& dst = to_disk ? static_cast<ostream&>(out) : cout;
+    static const char* RCODE[] = { "NOERROR", "FORMERR", "SERVFAIL", "NXDOMAIN", "NOTIMP", "REFUSED" };
+    const char* cache_path = getenv("WDH_CACHE");
+    DnsCache cache(cache_path ? cache_path : "wdh_dns.cache");
+    size_t answered = 0, failed = 0;
+    auto t0 = chrono::steady_clock::now();
+    auto report = [&](const DnsResult& r) {
+        const char* type = DnsClient::type_name(r.qtype);
+        if (r.rcode < 0) { ++failed; dst << r.domain << " " << type << " TIMEOUT\n"; return; }
+        ++answered;
+        size_t shown = 0;
+        for (auto& a : r.answers) {
+            if (a.data.empty()) continue;
+            dst << r.domain << " " << DnsClient::type_name(a.type) << " " << a.data << " ttl=" << a.ttl << "\n";
+            ++shown;
+        }
+        if (r.rcode != 0) dst << r.domain << " " << type << " " << (r.rcode < 6 ? RCODE[r.rcode] : "RCODE" + to_string(r.rcode)) << "\n";
+        else if (!shown) dst << r.domain << " " << type << " NODATA\n";
+        if (r.truncated) dst << r.domain << " " << type << " (truncated)\n";
+        dst.flush();
+    };
+    // Cached answers are printed up front; only the misses go on the wire, so
+    // a warm cache still answers when no nameserver is reachable.
+    vector<pair<string, uint16_t>> misses;
+    for (auto& q : qs) {
+        DnsResult r;
+        if (cache.lookup(q.first, q.second, r)) { r.domain = q.first; report(r); }
+        else misses.push_back(q);
+    }
+    if (!misses.empty() && !dns.ok()) {
+        cout << "No usable nameserver (set WDH_DNS=host[:port]); " << misses.size() << " uncached queries skipped.\n";
+        failed += misses.size();
+    } else if (!misses.empty()) {
+        dns.resolve_all(misses, cap > 0 ? static_cast<size_t>(cap) : 256, [&](DnsResult&& r) {
+            cache.store(r);
+            report(r);
+        });
+    }
+    double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    cout << qs.size() << " queries via " << (dns.ok() ? dns.nameserver() : "cache only") << ": " << answered << " answered, "
+         << failed << " failed in " << fixed << setprecision(2) << secs << "s\n" << defaultfloat;
+    if (cache.ok())
+        cout << "Cache: " << cache.hits() << " hits, " << cache.misses() << " misses (all runs: "
+             << cache.total_hits() << " hits, " << cache.total_misses() << " misses)\n";
+    if (to_disk) cout << "Results saved to " << file << "\n";
+#endif
 }
 
+// Linux reads the kernel socket tables directly; elsewhere netstat is parsed
+// and the local address column's port compared exactly (":80" no longer
+// matches ":8080").
 void Tool::pchk() {
     int port = getInt("Port Please: ");
+    if (port < 0 || port > 65535) { cout << "Port must be 0-65535.\n"; return; }
+#if !OS_WIN
+    SocketTable t;
+    if (t.load()) {
+        auto hits = t.on_port(static_cast<uint16_t>(port));
+        for (auto* e : hits) cout << t.format(*e) << "\n";
+        if (hits.empty()) cout << "Nothing on port " << port << ".\n";
+        return;
+    }
+#endif
 #if OS_WIN
     string out = run_capture("netstat -ano");
 #else
     string out = run_capture("netstat -pnltu");
 #endif
-    string needle = ":" + to_string(port);
     istringstream iss(out);
     string line;
     while (getline(iss, line)) {
-        if (line.find(needle) != string::npos) cout << line << "\n";
+        istringstream ls(line);
+        string proto, a, b, local;
+        if (!(ls >> proto)) continue;
+        // Windows: proto local ...; Unix: proto recv-q send-q local ...
+        if (OS_WIN) ls >> local; else ls >> a >> b >> local;
+        size_t sep = local.find_last_of(":.");
+        if (sep != string::npos && local.compare(sep + 1, string::npos, to_string(port)) == 0) cout << line << "\n";
     }
 }
 
+// Each tick re-reads the socket tables and compares the new snapshot with
+// the previous one; only differences are printed. Owners are looked up (and
+// /proc walked) only on ticks that have a new listener.
+void Tool::pwatch() {
+#if OS_WIN
+    cout << "pwatch needs /proc/net (Linux).\n";
+#else
+    double interval = getDouble("Interval seconds (default 1): ");
+    if (interval <= 0) interval = 1;
+    int iterations = getInt("Iterations (0 = until interrupted): ");
+    SocketTable t;
+    if (!t.load()) { cout << "pwatch needs /proc/net (Linux).\n"; return; }
+    PortSnapshot prev = t.snapshot();
+    size_t listeners = 0;
+    for (auto& kv : prev) listeners += kv.second.listening;
+    cout << "Watching " << listeners << " listeners, " << t.entries().size() << " sockets.\n";
+
+    auto stamp = [] {
+        time_t now = time(nullptr);
+        char b[16];
+        strftime(b, sizeof b, "%H:%M:%S", localtime(&now));
+        return string(b);
+    };
+    for (int i = 0; iterations <= 0 || i < iterations; ++i) {
+        this_thread::sleep_for(chrono::duration<double>(interval));
+        if (!t.load()) break;
+        PortSnapshot cur = t.snapshot();
+        string ts = stamp();
+        for (auto& kv : cur) {
+            const SockKey& k = kv.first;
+            auto old = prev.find(k);
+            const PortState none;
+            const PortState& was = old == prev.end() ? none : old->second;
+            string ep = SocketTable::endpoint(k.proto, k.addr, k.port);
+            const char* proto = SocketTable::PROTO[k.proto];
+            if (kv.second.listening && !was.listening)
+                cout << ts << " + listen " << proto << " " << ep << " " << t.owner(kv.second.inode) << "\n";
+            if (!kv.second.listening && was.listening)
+                cout << ts << " - listen " << proto << " " << ep << "\n";
+            if (kv.second.conns != was.conns)
+                cout << ts << "   conns  " << proto << " " << ep << " " << was.conns << " -> " << kv.second.conns
+                     << " (" << showpos << long(kv.second.conns) - long(was.conns) << noshowpos << ")\n";
+        }
+        for (auto& kv : prev) {
+            if (cur.count(kv.first)) continue;
+            string ep = SocketTable::endpoint(kv.first.proto, kv.first.addr, kv.first.port);
+            const char* proto = SocketTable::PROTO[kv.first.proto];
+            if (kv.second.listening) cout << ts << " - listen " << proto << " " << ep << "\n";
+            if (kv.second.conns)
+                cout << ts << "   conns  " << proto << " " << ep << " " << kv.second.conns << " -> 0 (-" << kv.second.conns << ")\n";
+        }
+        cout.flush();
+        prev = move(cur);
+    }
+#endif
+}
+
 void Tool::print_help() {
     for (auto& s : CMDS) cout << s << "\n";
 }
@@ -362,14 +2988,22 @@ void Tool::run() {
         else if (cmd == "write")  write_file();
         else if (cmd == "append") append_file();
         else if (cmd == "sfile")  sfile();
+        else if (cmd == "sbench") sbench();
+        else if (cmd == "sindex") sindex();
         else if (cmd == "mkpasswd") mkpasswd();
+        else if (cmd == "mkpasswdb") mkpasswd_bulk();
         else if (cmd == "guess")  guess();
         else if (cmd == "calc")   calc();
+        else if (cmd == "calcb")  calc_batch();
+        else if (cmd == "calcbench") calcbench();
+        else if (cmd == "simdbench") simdbench();
+        else if (cmd == "lexbench")  lexbench();
         else if (cmd == "local")  local_info();
         else if (cmd == "osi")    osi();
         else if (cmd == "ohd")    ohd();
         else if (cmd == "wdh")    wdh();
         else if (cmd == "pchk")   pchk();
+        else if (cmd == "pwatch") pwatch();
         else cout << "Unknown command.\n";
     }
 }
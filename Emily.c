@@ -1,13 +1,37 @@
+#define _DEFAULT_SOURCE   // madvise/MADV_SEQUENTIAL, readlink under -std=c11
+#ifdef _WIN32
+#define _CRT_RAND_S   // rand_s() from stdlib.h
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 #include <time.h>
+#include <locale.h>
+#include <errno.h>
+#include <stdint.h>
 
 #ifdef _WIN32
 #define OS_WIN 1
 #else
 #define OS_WIN 0
+#include <arpa/inet.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/random.h>
+#endif
+extern char **environ;
+#endif
+#if defined(__SSE2__)
+#include <emmintrin.h>
 #endif
 
 // -------- Utilities --------
@@ -25,21 +49,171 @@ static void getInputStr(const char *msg, char *out, size_t cap){
     if(fgets(out,cap,stdin)) trim_newline(out); else out[0]='\0';
 }
 
+// Growable byte buffer, always NUL-terminated once anything was appended.
+typedef struct { char *data; size_t len, cap; } Buf;
+
+static int buf_append(Buf *b, const char *src, size_t n){
+    if(b->len + n + 1 > b->cap){
+        size_t cap = b->cap ? b->cap : 4096;
+        while(cap < b->len + n + 1) cap *= 2;
+        char *nb = (char*)realloc(b->data, cap);
+        if(!nb) return 0;
+        b->data = nb; b->cap = cap;
+    }
+    memcpy(b->data + b->len, src, n);
+    b->len += n;
+    b->data[b->len] = '\0';
+    return 1;
+}
+
 // Capture an external command's stdout into a malloc'd buffer (caller frees).
-static char* cmd_capture(const char *cmd){
+// Reads 64 KB at a time and appends at the tracked end of the buffer. If
+// status is non-NULL it gets the exit code (128 + signal), or -1.
+static char* cmd_capture(const char *cmd, int *status){
+    if(status) *status = -1;
     FILE *fp = popen(cmd, "r");
     if(!fp) return NULL;
-    size_t cap = 4096, len = 0;
-    char *buf = (char*)malloc(cap); if(!buf){ pclose(fp); return NULL; }
-    buf[0]='\0';
-    char tmp[1024];
-    while(fgets(tmp,sizeof(tmp),fp)){
-        size_t need = len + strlen(tmp) + 1;
-        if(need > cap){ cap = need*2; char *nb=(char*)realloc(buf,cap); if(!nb){ free(buf); pclose(fp); return NULL; } buf=nb; }
-        strcpy(buf+len, tmp); len += strlen(tmp);
-    }
-    pclose(fp);
-    return buf;
+    Buf b = { NULL, 0, 0 };
+    static char tmp[1 << 16];
+    size_t n;
+    int ok = buf_append(&b, "", 0);
+    while(ok && (n = fread(tmp, 1, sizeof(tmp), fp)) > 0) ok = buf_append(&b, tmp, n);
+    int st = pclose(fp);
+#if OS_WIN
+    if(status) *status = st;
+#else
+    if(status && st != -1) *status = WIFEXITED(st) ? WEXITSTATUS(st) : 128 + (WIFSIGNALED(st) ? WTERMSIG(st) : 0);
+#endif
+    if(!ok){ free(b.data); return NULL; }
+    return b.data;
+}
+
+// -------- Concurrent command execution --------
+// Result of one command run by cmd_run_many; out/err are malloc'd (caller
+// frees with proc_free), status is the exit code or 128 + signal.
+typedef struct {
+    char *out, *err;
+    int status, started, timed_out, cancelled;
+    double secs;
+} ProcOut;
+
+static void proc_free(ProcOut *r, size_t n){
+    for(size_t i = 0; i < n; ++i){ free(r[i].out); free(r[i].err); r[i].out = r[i].err = NULL; }
+}
+
+static double now_secs(void){
+#if OS_WIN
+    return (double)clock() / CLOCKS_PER_SEC;
+#else
+    struct timespec ts; clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+#if !OS_WIN
+static int spawn_sh(const char *cmd, pid_t *pid, int fd[2]){
+    int po[2], pe[2];
+    if(pipe(po) != 0) return 0;
+    if(pipe(pe) != 0){ close(po[0]); close(po[1]); return 0; }
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_addopen(&fa, 0, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&fa, po[1], 1);
+    posix_spawn_file_actions_adddup2(&fa, pe[1], 2);
+    posix_spawn_file_actions_addclose(&fa, po[0]); posix_spawn_file_actions_addclose(&fa, po[1]);
+    posix_spawn_file_actions_addclose(&fa, pe[0]); posix_spawn_file_actions_addclose(&fa, pe[1]);
+    posix_spawnattr_t at;
+    posix_spawnattr_init(&at);
+    posix_spawnattr_setflags(&at, POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&at, 0);
+    char *argv[] = { "sh", "-c", (char*)cmd, NULL };
+    int rc = posix_spawn(pid, "/bin/sh", &fa, &at, argv, environ);
+    posix_spawn_file_actions_destroy(&fa);
+    posix_spawnattr_destroy(&at);
+    close(po[1]); close(pe[1]);
+    if(rc != 0){ close(po[0]); close(pe[0]); return 0; }
+    fd[0] = po[0]; fd[1] = pe[0];
+    for(int s = 0; s < 2; ++s){ fcntl(fd[s], F_SETFL, fcntl(fd[s], F_GETFL) | O_NONBLOCK); fcntl(fd[s], F_SETFD, FD_CLOEXEC); }
+    return 1;
+}
+#endif
+
+// Runs n shell commands at once (posix_spawn + poll on POSIX, one after the
+// other through popen on Windows). stdout and stderr are read 64 KB at a time
+// into separate buffers. timeout_ms <= 0 disables the timeout; once *cancel
+// becomes non-zero every remaining command's process group is killed.
+static void cmd_run_many(const char **cmds, size_t n, int timeout_ms, volatile const int *cancel, ProcOut *res){
+    memset(res, 0, n * sizeof(*res));
+    for(size_t i = 0; i < n; ++i) res[i].status = -1;
+#if OS_WIN
+    for(size_t i = 0; i < n; ++i){
+        if(cancel && *cancel){ res[i].cancelled = 1; continue; }
+        double t0 = now_secs();
+        res[i].out = cmd_capture(cmds[i], &res[i].status);
+        res[i].started = res[i].out != NULL;
+        res[i].secs = now_secs() - t0;
+    }
+    (void)timeout_ms;
+#else
+    pid_t *pid = (pid_t*)calloc(n ? n : 1, sizeof(pid_t));
+    int *fds = (int*)malloc((n ? n : 1) * 2 * sizeof(int));
+    int *killed = (int*)calloc(n ? n : 1, sizeof(int));
+    double *t0 = (double*)calloc(n ? n : 1, sizeof(double));
+    struct pollfd *pfds = (struct pollfd*)malloc((n ? n : 1) * 2 * sizeof(struct pollfd));
+    size_t *owner = (size_t*)malloc((n ? n : 1) * 2 * sizeof(size_t));
+    Buf *bufs = (Buf*)calloc((n ? n : 1) * 2, sizeof(Buf));
+    static char chunk[1 << 16];
+    size_t live = 0;
+    if(!pid || !fds || !killed || !t0 || !pfds || !owner || !bufs) n = 0;
+    for(size_t i = 0; i < n; ++i){
+        fds[2*i] = fds[2*i+1] = -1;
+        if(cancel && *cancel){ res[i].cancelled = 1; continue; }
+        t0[i] = now_secs();
+        if(spawn_sh(cmds[i], &pid[i], &fds[2*i])){ res[i].started = 1; ++live; }
+    }
+    while(live > 0){
+        nfds_t np = 0;
+        for(size_t k = 0; k < 2*n; ++k) if(fds[k] >= 0){ pfds[np].fd = fds[k]; pfds[np].events = POLLIN; pfds[np].revents = 0; owner[np++] = k; }
+        if(np) poll(pfds, np, 50);
+        else { struct timespec ts = { 0, 5000000 }; nanosleep(&ts, NULL); }
+        for(nfds_t j = 0; j < np; ++j){
+            if(!(pfds[j].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+            size_t k = owner[j];
+            for(;;){
+                ssize_t got = read(fds[k], chunk, sizeof(chunk));
+                if(got > 0){ buf_append(&bufs[k], chunk, (size_t)got); continue; }
+                if(got < 0 && errno == EINTR) continue;
+                if(got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+                close(fds[k]); fds[k] = -1;
+                break;
+            }
+        }
+        int stop = cancel && *cancel;
+        double now = now_secs();
+        for(size_t i = 0; i < n; ++i){
+            if(!res[i].started || res[i].secs > 0 || pid[i] == 0) continue;
+            if(!killed[i] && (stop || (timeout_ms > 0 && (now - t0[i]) * 1000.0 >= timeout_ms))){
+                kill(-pid[i], SIGKILL);
+                killed[i] = 1;
+                if(stop) res[i].cancelled = 1; else res[i].timed_out = 1;
+            }
+            if(!killed[i] && (fds[2*i] >= 0 || fds[2*i+1] >= 0)) continue;
+            int st = 0;
+            if(waitpid(pid[i], &st, killed[i] ? 0 : WNOHANG) != pid[i]) continue;
+            for(int s = 0; s < 2; ++s) if(fds[2*i+s] >= 0){ close(fds[2*i+s]); fds[2*i+s] = -1; }
+            res[i].status = WIFEXITED(st) ? WEXITSTATUS(st) : 128 + (WIFSIGNALED(st) ? WTERMSIG(st) : 0);
+            res[i].secs = now_secs() - t0[i];
+            if(res[i].secs <= 0) res[i].secs = 1e-9;
+            pid[i] = 0;
+            --live;
+        }
+    }
+    for(size_t i = 0; i < n; ++i){
+        res[i].out = bufs[2*i].data ? bufs[2*i].data : (char*)calloc(1, 1);
+        res[i].err = bufs[2*i+1].data ? bufs[2*i+1].data : (char*)calloc(1, 1);
+    }
+    free(pid); free(fds); free(killed); free(t0); free(pfds); free(owner); free(bufs);
+#endif
 }
 static int cmd_run(const char *cmd){
     int rc = system(cmd);
@@ -47,6 +221,114 @@ static int cmd_run(const char *cmd){
     return rc;
 }
 
+// Whole-file read-only view: mmap on POSIX, a malloc'd copy on Windows and
+// for anything that can't be mapped (pipes, devices, size-0 /proc files).
+typedef struct { const char *data; size_t len; int mapped; } FileView;
+
+static int read_stream(FILE *f, FileView *fv){
+    size_t cap = 1 << 16, len = 0;
+    char *buf = (char*)malloc(cap);
+    size_t got;
+    while(buf && (got = fread(buf + len, 1, cap - len, f)) > 0){
+        len += got;
+        if(len == cap){ char *nb = (char*)realloc(buf, cap *= 2); if(!nb){ free(buf); buf = NULL; } else buf = nb; }
+    }
+    int failed = ferror(f);
+    fclose(f);
+    if(!buf || failed){ free(buf); return 0; }
+    fv->data = buf; fv->len = len;
+    return 1;
+}
+
+static int map_file(const char *path, FileView *fv){
+    fv->data = NULL; fv->len = 0; fv->mapped = 0;
+#if OS_WIN
+    FILE *f = fopen(path, "rb");
+    return f ? read_stream(f, fv) : 0;
+#else
+    int fd = open(path, O_RDONLY);
+    if(fd < 0) return 0;
+    struct stat st;
+    if(fstat(fd, &st) != 0){ close(fd); return 0; }
+    if(!S_ISREG(st.st_mode) || st.st_size == 0){
+        FILE *f = fdopen(fd, "rb");
+        if(!f){ close(fd); return 0; }
+        return read_stream(f, fv);
+    }
+    fv->len = (size_t)st.st_size;
+    void *m = mmap(NULL, fv->len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(m == MAP_FAILED){ close(fd); fv->len = 0; return 0; }
+    madvise(m, fv->len, MADV_SEQUENTIAL);
+    fv->data = (const char*)m; fv->mapped = 1;
+    close(fd);
+    return 1;
+#endif
+}
+
+static void unmap_file(FileView *fv){
+    if(fv->mapped){
+#if !OS_WIN
+        munmap((void*)fv->data, fv->len);
+#endif
+    } else {
+        free((void*)fv->data);
+    }
+    fv->data = NULL; fv->len = 0; fv->mapped = 0;
+}
+
+// -------- Case-insensitive search --------
+static char lower_ascii(char c){ return (c >= 'A' && c <= 'Z') ? (char)(c + 32) : c; }
+
+// First candidate byte for a lowercase letter f: SSE2 compares 16 bytes at a
+// time after OR-ing 0x20 (which folds 'A'..'Z' onto 'a'..'z').
+static const char* scan_alpha(const char *p, const char *end, char f){
+#if defined(__SSE2__)
+    const __m128i fold = _mm_set1_epi8(0x20), want = _mm_set1_epi8(f);
+    for(; p + 16 <= end; p += 16){
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_or_si128(_mm_loadu_si128((const __m128i*)p), fold), want));
+        if(mask) return p + __builtin_ctz((unsigned)mask);
+    }
+#endif
+    for(; p < end; ++p) if((*p | 0x20) == f) return p;
+    return NULL;
+}
+
+// needle must already be lowercase; returns the first match in [p, end).
+static const char* find_ci(const char *p, const char *end, const char *needle, size_t nlen){
+    if(nlen == 0) return p;
+    if((size_t)(end - p) < nlen) return NULL;
+    const char *last = end - nlen;
+    char f = needle[0];
+    int alpha = (f >= 'a' && f <= 'z');
+    while(p <= last){
+        const char *c = alpha ? scan_alpha(p, last + 1, f) : (const char*)memchr(p, f, (size_t)(last + 1 - p));
+        if(!c) return NULL;
+        size_t k = 1;
+        while(k < nlen && lower_ascii(c[k]) == needle[k]) ++k;
+        if(k == nlen) return c;
+        p = c + 1;
+    }
+    return NULL;
+}
+
+// Writes each matching line of [p, end) to out as it is found; returns the count.
+static size_t grep_view(const char *p, const char *end, const char *needle, size_t nlen, FILE *out){
+    size_t lines = 0;
+    const char *cur = p;
+    while(cur < end){
+        const char *hit = find_ci(cur, end, needle, nlen);
+        if(!hit) break;
+        const char *ls = hit;
+        while(ls > cur && ls[-1] != '\n') --ls;
+        const char *le = (const char*)memchr(hit, '\n', (size_t)(end - hit));
+        if(!le) le = end;
+        fwrite(ls, 1, (size_t)(le - ls), out); fputc('\n', out);
+        ++lines;
+        cur = le + 1;
+    }
+    return lines;
+}
+
 // -------- SafeCalc (recursive-descent for +,-,*,/,%,^ and unary +/-; integer // as floor div) --------
 typedef struct { const char *s; size_t i; } Parser;
 
@@ -55,11 +337,62 @@ static int match(Parser *p, char c){ skip_ws(p); if(p->s[p->i]==c){ p->i++; retu
 
 static double parse_expr(Parser* p); // forward
 
+// Locale-independent number lexer: digits [. digits] [e[+-]digits], read in
+// place. Up to 19 significant digits go into an integer mantissa; if it and
+// the power of ten are exact in a double (<= 2^53, |exp| <= 22) one multiply
+// or divide is correctly rounded. Longer literals are copied to a small
+// buffer with '.' swapped for the locale's decimal point and given to strtod.
+static const double pow10_tab[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static const char* lex_number(const char *s, double *out){
+    const char *q = s;
+    unsigned long long m = 0;
+    int digits = 0, e10 = 0, dot = 0, any = 0, truncated = 0;
+    for(;; ++q){
+        char c = *q;
+        if(c == '.'){ if(dot) break; dot = 1; continue; }
+        if(c < '0' || c > '9') break;
+        any = 1;
+        if(m == 0 && c == '0'){ if(dot) --e10; continue; }
+        if(digits < 19){ m = m*10 + (unsigned)(c - '0'); ++digits; if(dot) --e10; }
+        else { truncated = 1; if(!dot) ++e10; }
+    }
+    if(!any) return NULL;
+    if((*q == 'e' || *q == 'E') && (isdigit((unsigned char)q[1]) || ((q[1] == '+' || q[1] == '-') && isdigit((unsigned char)q[2])))){
+        const char *e = q + 1;
+        int neg = (*e == '-'), x = 0;
+        if(*e == '+' || *e == '-') ++e;
+        while(isdigit((unsigned char)*e)){ if(x < 100000) x = x*10 + (*e - '0'); ++e; }
+        e10 += neg ? -x : x;
+        q = e;
+    }
+    if(!truncated && m <= (1ULL << 53) && e10 >= -22 && e10 <= 22){
+        double v = (double)m;
+        *out = e10 < 0 ? v / pow10_tab[-e10] : v * pow10_tab[e10];
+        return q;
+    }
+    {
+        size_t n = (size_t)(q - s);
+        char small[128];
+        char *buf = n < sizeof(small) ? small : (char*)malloc(n + 1);
+        if(!buf) return NULL;
+        const char *dp = localeconv()->decimal_point;
+        for(size_t k = 0; k < n; ++k) buf[k] = (s[k] == '.' && dp && dp[0]) ? dp[0] : s[k];
+        buf[n] = '\0';
+        *out = strtod(buf, NULL);
+        if(buf != small) free(buf);
+    }
+    return q;
+}
+
 static double parse_number(Parser* p){
     skip_ws(p);
-    char *end = NULL;
-    double v = strtod(p->s + p->i, &end);
-    if(end == p->s + p->i) { fprintf(stderr,"Error: expected number near '%.8s'\n", p->s + p->i); return 0.0; }
+    double v = 0.0;
+    const char *end = lex_number(p->s + p->i, &v);
+    if(!end) { fprintf(stderr,"Error: expected number near '%.8s'\n", p->s + p->i); return 0.0; }
     p->i = (size_t)(end - p->s);
     return v;
 }
@@ -125,6 +458,299 @@ static int safe_eval(const char *expr, double *out){
     return 1;
 }
 
+// -------- Socket table --------
+// /proc/net/{tcp,tcp6,udp,udp6} parsed into a flat array, with an index sorted
+// by local port. The inode -> "pid/comm" map is built the first time an
+// owner is asked for, since walking /proc/*/fd dominates the cost.
+typedef struct {
+    uint8_t proto, state;           // proto: 0 tcp, 1 tcp6, 2 udp, 3 udp6
+    uint16_t lport, rport;
+    uint8_t laddr[16], raddr[16];   // network byte order; v4 uses the first 4
+    uint64_t inode;
+} SockEntry;
+
+typedef struct { uint64_t inode; char who[48]; } SockOwner;
+
+typedef struct {
+    SockEntry *ents; size_t n, cap;
+    uint32_t *by_port;
+    SockOwner *owners; size_t nowners, owners_cap; int owners_loaded;
+} SockTable;
+
+static const char *SOCK_PROTO[4] = { "tcp", "tcp6", "udp", "udp6" };
+
+static void sock_free(SockTable *t){
+    free(t->ents); free(t->by_port); free(t->owners);
+    memset(t, 0, sizeof(*t));
+}
+
+static int hexval(char c){
+    return c>='0'&&c<='9' ? c-'0' : c>='A'&&c<='F' ? c-'A'+10 : c>='a'&&c<='f' ? c-'a'+10 : -1;
+}
+static long long hex_field(const char **p, int digits){
+    long long v = 0;
+    for(int i=0;i<digits;++i){ int h = hexval(*(*p)++); if(h < 0) return -1; v = v*16 + h; }
+    return v;
+}
+// Addresses are printed as host-order 32-bit words; storing each word back
+// in host order gives the network-order bytes.
+static int sock_addr(const char **p, int v6, uint8_t *addr, uint16_t *port){
+    memset(addr, 0, 16);
+    for(int w=0; w<(v6?4:1); ++w){
+        long long v = hex_field(p, 8);
+        if(v < 0) return 0;
+        uint32_t u = (uint32_t)v;
+        memcpy(addr + 4*w, &u, 4);
+    }
+    if(*(*p)++ != ':') return 0;
+    long long pt = hex_field(p, 4);
+    if(pt < 0) return 0;
+    *port = (uint16_t)pt;
+    return 1;
+}
+
+static void sock_parse(SockTable *t, const char *text, uint8_t proto){
+    const char *p = strchr(text, '\n');   // skip header
+    while(p && *++p){
+        const char *eol = strchr(p, '\n');
+        const char *q = strchr(p, ':');
+        if(!q || (eol && q > eol)) break;
+        ++q; while(*q==' ') ++q;
+        SockEntry e; memset(&e, 0, sizeof e);
+        e.proto = proto;
+        long long st = -1;
+        if(sock_addr(&q, proto&1, e.laddr, &e.lport)){
+            while(*q==' ') ++q;
+            if(sock_addr(&q, proto&1, e.raddr, &e.rport)){ while(*q==' ') ++q; st = hex_field(&q, 2); }
+        }
+        if(st >= 0){
+            char *end = (char*)q;
+            for(int f=0; f<5; ++f){ while(*end==' ') ++end; while(*end && *end!=' ') ++end; }   // tx:rx tr:when retrnsmt uid timeout
+            e.state = (uint8_t)st;
+            e.inode = strtoull(end, NULL, 10);
+            if(t->n == t->cap){
+                size_t cap = t->cap ? t->cap*2 : 256;
+                SockEntry *ne = (SockEntry*)realloc(t->ents, cap*sizeof(*ne));
+                if(!ne) return;
+                t->ents = ne; t->cap = cap;
+            }
+            t->ents[t->n++] = e;
+        }
+        p = eol;
+    }
+}
+
+static const SockEntry *sort_base;
+static int by_lport(const void *a, const void *b){
+    uint16_t x = sort_base[*(const uint32_t*)a].lport, y = sort_base[*(const uint32_t*)b].lport;
+    return (x > y) - (x < y);
+}
+
+// Returns 0 when no table could be read (not Linux, or /proc unavailable).
+static int sock_load(SockTable *t){
+    memset(t, 0, sizeof(*t));
+    int any = 0;
+#ifdef __linux__
+    Buf b = { NULL, 0, 0 };
+    static char chunk[1 << 16];
+    for(uint8_t p=0; p<4; ++p){
+        char path[32]; snprintf(path, sizeof path, "/proc/net/%s", SOCK_PROTO[p]);
+        int fd = open(path, O_RDONLY);
+        if(fd < 0) continue;
+        b.len = 0;
+        ssize_t n;
+        buf_append(&b, "", 0);
+        while((n = read(fd, chunk, sizeof chunk)) > 0) buf_append(&b, chunk, (size_t)n);
+        close(fd);
+        any = 1;
+        if(b.data) sock_parse(t, b.data, p);
+    }
+    free(b.data);
+#endif
+    t->by_port = (uint32_t*)malloc((t->n ? t->n : 1) * sizeof(uint32_t));
+    if(!t->by_port){ t->n = 0; return any; }
+    for(size_t i=0; i<t->n; ++i) t->by_port[i] = (uint32_t)i;
+    sort_base = t->ents;
+    qsort(t->by_port, t->n, sizeof(uint32_t), by_lport);
+    return any;
+}
+
+// Index range [*first, *last) in by_port for entries on local port `port`.
+static void sock_on_port(const SockTable *t, uint16_t port, size_t *first, size_t *last){
+    size_t lo = 0, hi = t->n;
+    while(lo < hi){ size_t mid = (lo+hi)/2; if(t->ents[t->by_port[mid]].lport < port) lo = mid+1; else hi = mid; }
+    *first = lo;
+    while(lo < t->n && t->ents[t->by_port[lo]].lport == port) ++lo;
+    *last = lo;
+}
+
+static int by_inode(const void *a, const void *b){
+    uint64_t x = ((const SockOwner*)a)->inode, y = ((const SockOwner*)b)->inode;
+    return (x > y) - (x < y);
+}
+
+static void sock_load_owners(SockTable *t){
+    t->owners_loaded = 1;
+#ifdef __linux__
+    DIR *proc = opendir("/proc");
+    if(!proc) return;
+    struct dirent *d;
+    while((d = readdir(proc))){
+        if(!isdigit((unsigned char)d->d_name[0])) continue;
+        char path[300]; snprintf(path, sizeof path, "/proc/%s/fd", d->d_name);
+        DIR *fds = opendir(path);
+        if(!fds) continue;
+        char who[48] = "";
+        struct dirent *f;
+        while((f = readdir(fds))){
+            char lp[540], link[64];
+            snprintf(lp, sizeof lp, "/proc/%s/fd/%s", d->d_name, f->d_name);
+            ssize_t n = readlink(lp, link, sizeof link - 1);
+            if(n < 9 || memcmp(link, "socket:[", 8) != 0) continue;
+            link[n] = '\0';
+            if(!who[0]){
+                char comm[32] = "?";
+                snprintf(lp, sizeof lp, "/proc/%s/comm", d->d_name);
+                FILE *c = fopen(lp, "r");
+                if(c){ if(fgets(comm, sizeof comm, c)) trim_newline(comm); fclose(c); }
+                snprintf(who, sizeof who, "%.15s/%.31s", d->d_name, comm);
+            }
+            if(t->nowners == t->owners_cap){
+                size_t cap = t->owners_cap ? t->owners_cap*2 : 256;
+                SockOwner *no = (SockOwner*)realloc(t->owners, cap*sizeof(*no));
+                if(!no) break;
+                t->owners = no; t->owners_cap = cap;
+            }
+            t->owners[t->nowners].inode = strtoull(link + 8, NULL, 10);
+            memcpy(t->owners[t->nowners++].who, who, sizeof who);
+        }
+        closedir(fds);
+    }
+    closedir(proc);
+    qsort(t->owners, t->nowners, sizeof(SockOwner), by_inode);
+#endif
+}
+
+// "pid/comm" holding the socket, or "-" if unknown (other users' processes
+// are unreadable without root).
+static const char *sock_owner(SockTable *t, uint64_t inode){
+    if(!t->owners_loaded) sock_load_owners(t);
+    SockOwner key; key.inode = inode;
+    SockOwner *o = t->nowners ? (SockOwner*)bsearch(&key, t->owners, t->nowners, sizeof key, by_inode) : NULL;
+    return o ? o->who : "-";
+}
+
+static const char *sock_state(const SockEntry *e){
+    static const char *tcp[] = { "?", "ESTABLISHED", "SYN_SENT", "SYN_RECV", "FIN_WAIT1", "FIN_WAIT2",
+                                 "TIME_WAIT", "CLOSE", "CLOSE_WAIT", "LAST_ACK", "LISTEN", "CLOSING" };
+    if(e->proto >= 2) return e->state == 7 ? "UNCONN" : "ESTAB";
+    return e->state < 12 ? tcp[e->state] : "?";
+}
+
+static void sock_endpoint(uint8_t proto, const uint8_t *addr, uint16_t port, char *out, size_t cap){
+#if OS_WIN
+    (void)proto; (void)addr; snprintf(out, cap, "?:%u", port);
+#else
+    char a[INET6_ADDRSTRLEN] = "?";
+    inet_ntop(proto&1 ? AF_INET6 : AF_INET, addr, a, sizeof a);
+    char p[8] = "*";
+    if(port) snprintf(p, sizeof p, "%u", port);
+    snprintf(out, cap, proto&1 ? "[%s]:%s" : "%s:%s", a, p);
+#endif
+}
+
+static void sock_print(SockTable *t, const SockEntry *e){
+    char l[64], r[64];
+    sock_endpoint(e->proto, e->laddr, e->lport, l, sizeof l);
+    sock_endpoint(e->proto, e->raddr, e->rport, r, sizeof r);
+    printf("%-5s %-23s %-23s %-11s %s\n", SOCK_PROTO[e->proto], l, r, sock_state(e), sock_owner(t, e->inode));
+}
+
+// -------- ChaCha20 CSPRNG --------
+// Same engine as the C++ tool: ChaCha20 keystream with a 64-bit block
+// counter and 64-bit stream id, keyed once from the OS (getrandom, then
+// /dev/urandom; rand_s on Windows). Without OS randomness there is no key
+// and no passwords are generated.
+typedef struct { uint32_t s[16]; uint8_t buf[64]; size_t pos; } ChaCha20;
+
+static uint32_t rotl32(uint32_t v, int c){ return (v << c) | (v >> (32 - c)); }
+#define CHACHA_QR(a,b,c,d) \
+    a += b; d = rotl32(d ^ a, 16); c += d; b = rotl32(b ^ c, 12); \
+    a += b; d = rotl32(d ^ a, 8);  c += d; b = rotl32(b ^ c, 7)
+
+static void chacha_block(ChaCha20 *g){
+    uint32_t x[16];
+    memcpy(x, g->s, sizeof x);
+    for(int i=0;i<10;++i){
+        CHACHA_QR(x[0],x[4],x[8],x[12]); CHACHA_QR(x[1],x[5],x[9],x[13]); CHACHA_QR(x[2],x[6],x[10],x[14]); CHACHA_QR(x[3],x[7],x[11],x[15]);
+        CHACHA_QR(x[0],x[5],x[10],x[15]); CHACHA_QR(x[1],x[6],x[11],x[12]); CHACHA_QR(x[2],x[7],x[8],x[13]); CHACHA_QR(x[3],x[4],x[9],x[14]);
+    }
+    for(int i=0;i<16;++i){
+        uint32_t v = x[i] + g->s[i];
+        g->buf[4*i] = (uint8_t)v; g->buf[4*i+1] = (uint8_t)(v >> 8); g->buf[4*i+2] = (uint8_t)(v >> 16); g->buf[4*i+3] = (uint8_t)(v >> 24);
+    }
+    if(++g->s[12] == 0) ++g->s[13];
+    g->pos = 0;
+}
+
+// 1 once all 32 bytes came from the OS, 0 if it could not supply them.
+static int chacha_os_key(uint8_t key[32]){
+    size_t got = 0;
+#if OS_WIN
+    for(; got < 32; got += 4){
+        unsigned int v;
+        if(rand_s(&v) != 0) break;
+        memcpy(key + got, &v, 4);
+    }
+#endif
+#ifdef __linux__
+    while(got < 32){
+        ssize_t n = getrandom(key + got, 32 - got, 0);
+        if(n < 0){ if(errno == EINTR) continue; break; }
+        got += (size_t)n;
+    }
+#endif
+#if !OS_WIN
+    if(got < 32){
+        int fd = open("/dev/urandom", O_RDONLY);
+        if(fd >= 0){
+            ssize_t n;
+            while(got < 32 && (n = read(fd, key + got, 32 - got)) > 0) got += (size_t)n;
+            close(fd);
+        }
+    }
+#endif
+    return got == 32;
+}
+
+// Returns the process-wide engine, keying it on first use; NULL if the OS
+// gave no random key.
+static ChaCha20 *chacha_global(void){
+    static ChaCha20 g;
+    static int seeded = 0;
+    if(!seeded){
+        uint8_t key[32];
+        if(!chacha_os_key(key)) return NULL;
+        g.s[0]=0x61707865; g.s[1]=0x3320646e; g.s[2]=0x79622d32; g.s[3]=0x6b206574;
+        for(int i=0;i<8;++i) g.s[4+i] = (uint32_t)key[4*i] | (uint32_t)key[4*i+1] << 8 | (uint32_t)key[4*i+2] << 16 | (uint32_t)key[4*i+3] << 24;
+        g.s[12]=g.s[13]=g.s[14]=g.s[15]=0;
+        g.pos = 64;
+        seeded = 1;
+    }
+    return &g;
+}
+
+// Uniform in [0, n) for 1 <= n <= 256 by rejecting bytes past the largest
+// multiple of n.
+static unsigned chacha_below(ChaCha20 *g, unsigned n){
+    const unsigned limit = 256 - 256 % n;
+    for(;;){
+        if(g->pos == 64) chacha_block(g);
+        unsigned b = g->buf[g->pos++];
+        if(b < limit) return b % n;
+    }
+}
+
 // -------- Features --------
 static void mdir(){
     char name[512];
@@ -138,14 +764,29 @@ static void mdir(){
     char cwd[1024]; if(getcwd(cwd,sizeof(cwd))) printf("OK, have made a directory called: '%s'\nPATH: %s\n", name, cwd);
 }
 
+// Maps the file and hands it to stdout in 1 MB write() calls (fwrite on
+// Windows) instead of copying it through a 1 KB fgets buffer.
 static void read_file(){
     char fname[512];
     getInputStr("Filename:\n> ", fname, sizeof(fname));
-    FILE *f = fopen(fname, "r");
-    if(!f){ puts("File not found!"); return; }
-    char buf[1024];
-    while(fgets(buf,sizeof(buf),f)) fputs(buf, stdout);
-    fclose(f);
+    FileView fv;
+    if(!map_file(fname, &fv)){ puts("File not found!"); return; }
+    fflush(stdout);
+    const char *p = fv.data;
+    size_t left = fv.len;
+    while(left > 0){
+        size_t chunk = left < ((size_t)1 << 20) ? left : ((size_t)1 << 20);
+#if OS_WIN
+        size_t n = fwrite(p, 1, chunk, stdout);
+        if(n == 0) break;
+#else
+        ssize_t n = write(STDOUT_FILENO, p, chunk);
+        if(n < 0 && errno == EINTR) continue;
+        if(n <= 0) break;
+#endif
+        p += n; left -= (size_t)n;
+    }
+    unmap_file(&fv);
 }
 
 static void write_file(){
@@ -169,13 +810,14 @@ static void append_file(){
 static void sfile(){
     char fname[512]; getInputStr("Filename: ", fname, sizeof(fname));
     char search[512]; getInputStr("Search String: ", search, sizeof(search));
-#if OS_WIN
-    char cmd[2048]; snprintf(cmd,sizeof(cmd),"findstr /I /C:\"%s\" \"%s\"", search, fname);
-#else
-    char cmd[2048]; snprintf(cmd,sizeof(cmd),"grep -i -- \"%s\" \"%s\"", search, fname);
-#endif
-    char *out = cmd_capture(cmd);
-    if(out && out[0]){ printf("%s", out); free(out); } else { puts("No matches found."); if(out) free(out); }
+    FileView fv;
+    if(!map_file(fname, &fv)){ puts("File not found!"); return; }
+    size_t nlen = strlen(search);
+    for(size_t k = 0; k < nlen; ++k) search[k] = lower_ascii(search[k]);
+    size_t n = grep_view(fv.data, fv.data + fv.len, search, nlen, stdout);
+    fflush(stdout);
+    unmap_file(&fv);
+    if(!n) puts("No matches found.");
 }
 
 static void mkpasswd(){
@@ -183,13 +825,14 @@ static void mkpasswd(){
     const char *numbs="0123456789";
     const char *special="!^*£$";
     char pass[64] = {0};
-    srand((unsigned)time(NULL));
-    pass[0] = letters[rand()%26];
+    ChaCha20 *g = chacha_global();
+    if(!g){ puts("No OS random source available, not generating a password."); return; }
+    pass[0] = letters[chacha_below(g,26)];
     for(int i=1;i<8;i++){
-        int sel = rand()%3;
-        if(sel==0) pass[i]=letters[rand()%26];
-        else if(sel==1) pass[i]=numbs[rand()%10];
-        else pass[i]=special[rand()%5];
+        unsigned sel = chacha_below(g,3);
+        if(sel==0) pass[i]=letters[chacha_below(g,26)];
+        else if(sel==1) pass[i]=numbs[chacha_below(g,10)];
+        else pass[i]=special[chacha_below(g,5)];
     }
     pass[8]='\0';
     printf("Password is: %s\nLength: %zu\n", pass, strlen(pass));
@@ -224,10 +867,14 @@ static void local_info(){
 #else
     const char *cmds[] = { "w -i -p", "who -a", "service --status-all", "netstat -tuln" };
 #endif
-    for(size_t i=0;i<sizeof(cmds)/sizeof(cmds[0]);++i){
-        char *out = cmd_capture(cmds[i]);
-        if(out){ fputs(out,f); free(out); }
+    enum { NCMDS = sizeof(cmds)/sizeof(cmds[0]) };
+    ProcOut res[NCMDS];
+    cmd_run_many(cmds, NCMDS, 0, NULL, res);
+    for(size_t i=0;i<NCMDS;++i){
+        if(res[i].out) fputs(res[i].out,f);
+        if(res[i].err) fputs(res[i].err,stderr);
     }
+    proc_free(res, NCMDS);
     fclose(f);
     printf("System info written to %s\n", fname);
 }
@@ -271,32 +918,55 @@ static void wdh(){
     snprintf(cmd2,sizeof(cmd2),dig_cmd_fmt,domain);
     snprintf(cmd3,sizeof(cmd3),host_cmd_fmt,domain);
 
-    if(to_disk){
-        FILE *f = fopen(fname,"w"); if(!f){ puts("Could not open file."); return; }
-        char *o1=cmd_capture(cmd1); if(o1){ fputs(o1,f); free(o1); }
-        char *o2=cmd_capture(cmd2); if(o2){ fputs(o2,f); free(o2); }
-        char *o3=cmd_capture(cmd3); if(o3){ fputs(o3,f); free(o3); }
-        fclose(f);
-        printf("Results saved to %s\n", fname);
-    }else{
-        char *o1=cmd_capture(cmd1); if(o1){ printf("%s",o1); free(o1); }
-        char *o2=cmd_capture(cmd2); if(o2){ printf("%s",o2); free(o2); }
-        char *o3=cmd_capture(cmd3); if(o3){ printf("%s",o3); free(o3); }
+    FILE *f = stdout;
+    if(to_disk){ f = fopen(fname,"w"); if(!f){ puts("Could not open file."); return; } }
+    const char *cmds[] = { cmd1, cmd2, cmd3 };
+    ProcOut res[3];
+    cmd_run_many(cmds, 3, 0, NULL, res);
+    for(int i=0;i<3;++i){
+        if(res[i].out) fputs(res[i].out,f);
+        if(res[i].err) fputs(res[i].err,stderr);
     }
+    proc_free(res, 3);
+    if(to_disk){ fclose(f); printf("Results saved to %s\n", fname); }
 }
 
+// Linux reads the kernel socket tables directly; elsewhere netstat's local
+// address column is parsed and its port compared exactly, so ":80" no
+// longer matches ":8080".
 static void pchk(){
     int port = getInputInt("Port Please: ");
+    if(port < 0 || port > 65535){ puts("Port must be 0-65535."); return; }
+#if !OS_WIN
+    SockTable t;
+    if(sock_load(&t)){
+        size_t first, last;
+        sock_on_port(&t, (uint16_t)port, &first, &last);
+        for(size_t i=first; i<last; ++i) sock_print(&t, &t.ents[t.by_port[i]]);
+        if(first == last) printf("Nothing on port %d.\n", port);
+        sock_free(&t);
+        return;
+    }
+    sock_free(&t);
+#endif
 #if OS_WIN
-    char *out = cmd_capture("netstat -ano");
+    char *out = cmd_capture("netstat -ano", NULL);
 #else
-    char *out = cmd_capture("netstat -pnltu");
+    char *out = cmd_capture("netstat -pnltu", NULL);
 #endif
     if(!out){ return; }
-    char needle[64]; snprintf(needle,sizeof(needle),":%d",port);
+    char want[8]; snprintf(want,sizeof(want),"%d",port);
     char *line = strtok(out, "\n");
     while(line){
-        if(strstr(line, needle)) printf("%s\n", line);
+        // Windows: proto local ...; Unix: proto recv-q send-q local ...
+        char f[4][128];
+        int got = sscanf(line, "%127s %127s %127s %127s", f[0], f[1], f[2], f[3]);
+        const char *local = OS_WIN ? f[1] : f[3];
+        if(got >= (OS_WIN ? 2 : 4)){
+            const char *sep = strrchr(local, ':'), *dot = strrchr(local, '.');
+            if(!sep || (dot && dot > sep)) sep = dot;
+            if(sep && strcmp(sep+1, want) == 0) printf("%s\n", line);
+        }
         line = strtok(NULL, "\n");
     }
     free(out);
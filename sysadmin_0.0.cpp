@@ -6,22 +6,36 @@
 #include <ctime>
 #include <mutex>
 #include <map>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+#include <vector>
 #include <sstream>
+#include <unordered_map>
+#include <climits>
+#include <iomanip>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h> // for gethostname
 
-using namespace std;
+#define LOG_STAMP_FORMAT "%a %b %e %H:%M:%S %Y"   // ctime() layout
+#include "sysadmin_common.h"
 
-// Thread-safe logging utility
-mutex logMutex;
-ofstream logFile;
+using namespace std;
 
+// Messages carry their category as a "[Name] " prefix; the console echo is
+// synchronous so it stays in order with the output of the commands it
+// announces, and only the log file is written in the background.
 void logMessage(const string& message) {
-    lock_guard<mutex> lock(logMutex);
-    time_t now = time(0);
-    string dt = ctime(&now);
-    dt.pop_back();
-    logFile << "[" << dt << "] " << message << endl;
     cout << message << endl;
+    size_t close = message.size() > 2 && message[0] == '[' ? message.find("] ") : string::npos;
+    if (close == string::npos) AsyncLogger::instance().log("", message);
+    else AsyncLogger::instance().log(message.substr(1, close - 1), message.substr(close + 2));
 }
 
 // Abstract class
@@ -64,10 +78,7 @@ class LinuxUpdater : public OSUpdater {
 private:
     void log(const string& msg) { logMessage("[Linux] " + msg); }
 
-    bool commandExists(const string& cmd) {
-        string check = "command -v " + cmd + " > /dev/null 2>&1";
-        return (system(check.c_str()) == 0);
-    }
+    bool commandExists(const string& cmd) { return CommandCache::instance().exists(cmd); }
 
 public:
     void updateCache() override {
@@ -174,11 +185,53 @@ string gatherSystemInfo() {
     return ss.str();
 }
 
+// ----------------------
+// Inventory output
+// ----------------------
+// Each "Key: value" line of gatherSystemInfo() is a section named Key.
+vector<InventorySection> splitInventory(const string& info) {
+    vector<InventorySection> sections;
+    istringstream in(info);
+    for (string line; getline(in, line);) {
+        size_t colon = line.find(':');
+        sections.emplace_back(colon == string::npos ? line : line.substr(0, colon), line + "\n");
+    }
+    return sections;
+}
+
+// Writes the lines changed since the snapshot (plus "Key: (removed)" ones)
+// and updates the snapshot. "Current Time" differs on every run, so it is
+// always written and never hashed.
+void writeInventoryDelta(ostream& out, const string& info, const string& snapshot) {
+    vector<InventorySection> sections = splitInventory(info);
+    string volatileLines;
+    sections.erase(remove_if(sections.begin(), sections.end(), [&](const InventorySection& s) {
+        if (s.first != "Current Time") return false;
+        volatileLines += s.second;
+        return true;
+    }), sections.end());
+    InventorySnapshot snap(snapshot);
+    vector<string> removed;
+    vector<InventorySection> delta = snap.changed(sections, removed);
+    for (auto& s : delta) out << s.second;
+    for (auto& r : removed) out << r << ": (removed)\n";
+    if (delta.empty() && removed.empty()) out << "No changes since last snapshot.\n";
+    out << volatileLines;
+    if (!snap.save(sections)) cerr << "Could not write snapshot " << snapshot << endl;
+}
+
 void showHelp() {
     cout << "Usage:\n";
-    cout << "  --h [-f file]     Perform system update (log to file, default system_update.log)\n";
+    cout << "  --h [-f file] [--binlog]\n";
+    cout << "                    Perform system update (log to file, default system_update.log;\n";
+    cout << "                    --binlog also writes file.bin/.idx)\n";
     cout << "  --os [-f file]    Show detected OS (or log to file)\n";
-    cout << "  --info [-f file]  Show system info (or log to file)\n";
+    cout << "  --info [-f file] [--delta [snap]]\n";
+    cout << "                    Show system info (or log to file); --delta shows only\n";
+    cout << "                    what changed since the snapshot (default inventory.snap)\n";
+    cout << "  --readlog [file] [-c category] [--since T] [--until T]\n";
+    cout << "                    Print the binary log of file; T is epoch seconds,\n";
+    cout << "                    YYYY-MM-DD or \"YYYY-MM-DD HH:MM:SS\"\n";
     cout << "  --help            Show this help message\n";
 }
 
@@ -187,17 +240,20 @@ int main(int argc, char* argv[]) {
 
     // default log file if none provided
     string logFilename = "system_update.log";
+    bool binlog = false;
 
     if (argc > 1) {
         string arg1 = argv[1];
 
         if (arg1 == "--h") {
-            if (argc > 3 && string(argv[2]) == "-f") {
-                logFilename = argv[3];
+            for (int i = 2; i < argc; ++i) {
+                string opt = argv[i];
+                if (opt == "-f" && i + 1 < argc) logFilename = argv[++i];
+                else if (opt == "--binlog") binlog = true;
             }
-            logFile.open(logFilename, ios::app);
+            if (binlog) AsyncLogger::instance().enableBinary(logFilename);
+            AsyncLogger::instance().open(logFilename);
             manager.performUpdate();
-            logFile.close();
             return 0;
         }
         else if (arg1 == "--os") {
@@ -211,15 +267,40 @@ int main(int argc, char* argv[]) {
             return 0;
         }
         else if (arg1 == "--info") {
-            string info = gatherSystemInfo();
-            if (argc > 3 && string(argv[2]) == "-f") {
-                ofstream out(argv[3]);
-                out << info;
-            } else {
-                cout << info;
+            string outFile, snapshot;
+            for (int i = 2; i < argc; ++i) {
+                string opt = argv[i];
+                if (opt == "-f" && i + 1 < argc) outFile = argv[++i];
+                else if (opt == "--delta") {
+                    snapshot = "inventory.snap";
+                    if (i + 1 < argc && argv[i + 1][0] != '-') snapshot = argv[++i];
+                }
             }
+            string info = gatherSystemInfo();
+            ofstream file;
+            if (!outFile.empty()) file.open(outFile);
+            ostream& out = outFile.empty() ? cout : file;
+            if (snapshot.empty()) out << info;
+            else writeInventoryDelta(out, info, snapshot);
             return 0;
         }
+        else if (arg1 == "--readlog") {
+            string base = logFilename, category;
+            int64_t since = INT64_MIN, until = INT64_MAX;
+            int i = 2;
+            if (i < argc && argv[i][0] != '-') base = argv[i++];
+            for (; i + 1 < argc; i += 2) {
+                string opt = argv[i], val = argv[i + 1];
+                if (opt == "-c") category = val;
+                else if (opt == "--since" || opt == "--until") {
+                    int64_t t = parseTime(val);
+                    if (t < 0) { cerr << "Bad time: " << val << endl; return 1; }
+                    (opt == "--since" ? since : until) = t;
+                } else { cerr << "Unknown option: " << opt << endl; return 1; }
+            }
+            if (i < argc) { cerr << "Missing value for " << argv[i] << endl; return 1; }
+            return readLog(base, category, since, until);
+        }
         else if (arg1 == "--help") {
             showHelp();
             return 0;
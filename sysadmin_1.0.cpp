@@ -7,27 +7,146 @@
 #include <thread>
 #include <mutex>
 #include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <climits>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <sys/statvfs.h>
+#include <sys/utsname.h>
+#endif
+#include "sysadmin_common.h"
 using namespace std;
 
-mutex logMutex;  // To prevent race conditions when logging from multiple threads
-
 // Utility function for logging
 void logMessage(const string& category, const string& message) {
-    lock_guard<mutex> guard(logMutex); // Thread-safe logging
-    ofstream logFile("update_log.txt", ios::app);
-    if (!logFile) {
-        cerr << "Error opening log file!" << endl;
-        return;
-    }
-    time_t now = time(nullptr);
-    char timeStr[100];
-    strftime(timeStr, sizeof(timeStr), "%Y-%m-%d %H:%M:%S", localtime(&now));
-    logFile << "[" << timeStr << "] [" << category << "] " << message << endl;
+    AsyncLogger::instance().log(category, message);
 }
 
 // Utility function to check if a command exists
 bool commandExists(const string& cmd) {
-    return system((cmd + " --version > /dev/null 2>&1").c_str()) == 0;
+#ifdef _WIN32
+    return system((cmd + " --version > nul 2>&1").c_str()) == 0;
+#else
+    return CommandCache::instance().exists(cmd);
+#endif
+}
+
+// ----------------------
+// Transports
+// ----------------------
+// Where an updater's commands run: this machine (optionally from a working
+// directory) or another host over ssh. With an output file set, command
+// output is appended there instead of going to the terminal.
+string shellQuote(const string& s) {
+#ifdef _WIN32
+    return "\"" + s + "\"";
+#else
+    string q = "'";
+    for (char c : s) q += c == '\'' ? string("'\\''") : string(1, c);
+    return q + "'";
+#endif
+}
+
+// Exit code from a system() status; -1 if the command did not exit normally.
+int exitCode(int status) {
+#ifdef _WIN32
+    return status;
+#else
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+#endif
+}
+
+class Transport {
+public:
+    virtual ~Transport() {}
+    // Status as returned by system(); see exitCode().
+    int run(const string& cmd) {
+        string full = wrap(cmd);
+        if (!output.empty()) full = "(" + full + ") >> " + shellQuote(output) + " 2>&1";
+        return system(full.c_str());
+    }
+    virtual bool commandExists(const string& cmd) = 0;
+    // Whether commands can be run there at all.
+    virtual bool reachable() { return true; }
+    // Whether commands run on this machine (so it can be inspected directly).
+    virtual bool local() const = 0;
+    void setOutput(const string& path) { output = path; }
+protected:
+    virtual string wrap(const string& cmd) const = 0;
+private:
+    string output;
+};
+
+class LocalTransport : public Transport {
+public:
+    explicit LocalTransport(string dir = "") : dir(move(dir)) {}
+    bool commandExists(const string& cmd) override { return ::commandExists(cmd); }
+    bool reachable() override { return dir.empty() || filesystem::is_directory(dir); }
+    bool local() const override { return true; }
+protected:
+    string wrap(const string& cmd) const override { return dir.empty() ? cmd : "cd " + shellQuote(dir) + " && " + cmd; }
+private:
+    string dir;
+};
+
+// Probes run remotely with `command -v` and are memoized per host, except
+// when ssh itself failed (exit 255), which says nothing about the command.
+// ssh gets -n so concurrent sessions never read this process's stdin.
+class SshTransport : public Transport {
+public:
+    explicit SshTransport(string dest) : dest(move(dest)) {}
+    bool commandExists(const string& cmd) override {
+        {
+            lock_guard<mutex> guard(m);
+            auto it = known.find(cmd);
+            if (it != known.end()) return it->second;
+        }
+        int rc = exitCode(run("command -v " + shellQuote(cmd) + " > /dev/null 2>&1"));
+        if (rc == 255) return false;
+        lock_guard<mutex> guard(m);
+        known.emplace(cmd, rc == 0);
+        return rc == 0;
+    }
+    bool reachable() override { return exitCode(run("true")) != 255; }
+    bool local() const override { return false; }
+protected:
+    string wrap(const string& cmd) const override {
+        return "ssh -n -o BatchMode=yes -o ConnectTimeout=10 " + shellQuote(dest) + " " + shellQuote(cmd);
+    }
+private:
+    string dest;
+    mutex m;
+    unordered_map<string, bool> known;
+};
+
+Transport& localTransport() {
+    static LocalTransport local;
+    return local;
 }
 
 class OSUpdater {
@@ -38,62 +157,110 @@ public:
     virtual void updateFirmware() = 0;
     virtual void updateCache() = 0;
     virtual void gatherSystemInfo() = 0;
+    // True when updateFirmware drives the same tool as the package update,
+    // so it must not run alongside it.
+    virtual bool firmwareUsesPackageTool() const { return false; }
     virtual ~OSUpdater() {}
+
+    // Runs this updater's commands through t; host tags its log lines.
+    void setTransport(Transport& t, const string& host) {
+        transport = &t;
+        hostTag = host.empty() ? "" : "[" + host + "] ";
+    }
+    // Commands that exited non-zero, plus steps skipped for a missing tool
+    // or an unsupported distribution, so far.
+    size_t failures() const { return failed.load(); }
+    // The same count for the calling thread only, across all updaters. Each
+    // step runs on one thread, so its before/after difference is that
+    // step's failures even while other steps run alongside it.
+    static size_t threadFailures() { return threadFailed(); }
+    // gatherSystemInfo prints only what changed since this snapshot file.
+    void setSnapshot(const string& path) { snapshotPath = path; }
+
+protected:
+    string hostTag, snapshotPath;
+    // Exit code of cmd, or 0 when it is one of `ok` (some tools use non-zero
+    // codes for success, e.g. dnf check-update exits 100 when updates are
+    // pending and fwupdmgr exits 2 when there is nothing to do).
+    int run(const string& cmd, initializer_list<int> ok = {0}) {
+        int rc = exitCode(transport->run(cmd));
+        if (find(ok.begin(), ok.end(), rc) != ok.end()) return 0;
+        markFailed();
+        return rc;
+    }
+    bool has(const string& cmd) { return transport->commandExists(cmd); }
+    // has(), but a missing tool counts as a failure (the step cannot run).
+    bool require(const string& cmd) {
+        if (has(cmd)) return true;
+        markFailed();
+        return false;
+    }
+    void markFailed() { ++failed; ++threadFailed(); }
+    bool local() const { return transport->local(); }
+
+private:
+    Transport* transport = &localTransport();
+    atomic<size_t> failed{0};
+    static size_t& threadFailed() {
+        thread_local size_t n = 0;
+        return n;
+    }
 };
 
 class OSXUpdater : public OSUpdater {
 public:
     void checkForUpdates() override {
         log("Checking for updates on macOS...");
-        if (system("softwareupdate -l") != 0) {
+        if (run("softwareupdate -l") != 0) {
             log("Failed to check for updates on macOS.");
         }
     }
     void performUpdate() override {
         log("Performing macOS update...");
-        if (system("softwareupdate --install --all") != 0) {
+        if (run("softwareupdate --install --all") != 0) {
             log("Failed to perform macOS update.");
         }
     }
     void handleDependencies() override {
         log("Handling macOS dependencies...");
-        if (system("brew update && brew upgrade") != 0) {
+        if (run("brew update && brew upgrade") != 0) {
             log("Failed to handle dependencies on macOS.");
         }
     }
     void updateFirmware() override {
         log("Updating firmware on macOS...");
-        if (system("softwareupdate --fetch-full-installer") != 0) {
+        if (run("softwareupdate --fetch-full-installer") != 0) {
             log("Failed to update firmware on macOS.");
         }
-        if (system("softwareupdate --install --all") != 0) {
+        if (run("softwareupdate --install --all") != 0) {
             log("Failed to install macOS firmware.");
         }
     }
     void updateCache() override {
         log("Updating cache on macOS...");
-        if (system("softwareupdate --fetch-full-installer") != 0) {
+        if (run("softwareupdate --fetch-full-installer") != 0) {
             log("Failed to update cache on macOS.");
         }
     }
+    bool firmwareUsesPackageTool() const override { return true; }   // softwareupdate
     void gatherSystemInfo() override {
         log("Gathering system information for macOS...");
-        if (system("system_profiler SPHardwareDataType SPSoftwareDataType SPDiskDataType") != 0) {
+        if (run("system_profiler SPHardwareDataType SPSoftwareDataType SPDiskDataType") != 0) {
             log("Failed to gather system information on macOS.");
         }
-        if (system("system_profiler SPFirmwareDataType") != 0) {
+        if (run("system_profiler SPFirmwareDataType") != 0) {
             log("Failed to gather firmware information on macOS.");
         }
-        if (system("diskutil list") != 0) {
+        if (run("diskutil list") != 0) {
             log("Failed to gather disk information on macOS.");
         }
-        if (system("brew list --versions") != 0) {
+        if (run("brew list --versions") != 0) {
             log("Failed to list installed apps via brew on macOS.");
         }
     }
 private:
     void log(const string& message) {
-        logMessage("macOS", message);
+        logMessage("macOS", hostTag + message);
     }
 };
 
@@ -101,242 +268,897 @@ class WindowsUpdater : public OSUpdater {
 public:
     void checkForUpdates() override {
         log("Checking for updates on Windows...");
-        if (system("powershell -Command Get-WindowsUpdate") != 0) {
+        if (run("powershell -Command Get-WindowsUpdate") != 0) {
             log("Failed to check for updates on Windows.");
         }
     }
     void performUpdate() override {
         log("Performing Windows update...");
-        if (system("powershell -Command Install-WindowsUpdate -AcceptAll -AutoReboot") != 0) {
+        if (run("powershell -Command Install-WindowsUpdate -AcceptAll -AutoReboot") != 0) {
             log("Failed to perform Windows update.");
         }
     }
     void handleDependencies() override {
         log("Handling Windows dependencies...");
-        if (system("choco upgrade all -y") != 0) {
+        if (run("choco upgrade all -y") != 0) {
             log("Failed to handle dependencies on Windows.");
         }
     }
     void updateFirmware() override {
         log("Updating firmware on Windows...");
-        if (system("fwupdmgr refresh") != 0) {
+        if (run("fwupdmgr refresh", {0, 2}) != 0) {
             log("Failed to refresh firmware on Windows.");
         }
-        if (system("fwupdmgr update") != 0) {
+        if (run("fwupdmgr update", {0, 2}) != 0) {
             log("Failed to update firmware on Windows.");
         }
     }
     void updateCache() override {
         log("Updating cache on Windows...");
-        if (system("powershell -Command Get-WindowsUpdate -Install") != 0) {
+        if (run("powershell -Command Get-WindowsUpdate -Install") != 0) {
             log("Failed to update cache on Windows.");
         }
     }
     void gatherSystemInfo() override {
         log("Gathering system information for Windows...");
-        if (system("systeminfo") != 0) {
+        if (run("systeminfo") != 0) {
             log("Failed to gather system info on Windows.");
         }
-        if (system("wmic bios get smbiosbiosversion") != 0) {
+        if (run("wmic bios get smbiosbiosversion") != 0) {
             log("Failed to gather firmware info on Windows.");
         }
-        if (system("wmic cpu get caption, deviceid, name, numberofcores, maxclockspeed") != 0) {
+        if (run("wmic cpu get caption, deviceid, name, numberofcores, maxclockspeed") != 0) {
             log("Failed to gather CPU info on Windows.");
         }
-        if (system("wmic diskdrive get model, size") != 0) {
+        if (run("wmic diskdrive get model, size") != 0) {
             log("Failed to gather disk info on Windows.");
         }
-        if (system("wmic product get name, version") != 0) {
+        if (run("wmic product get name, version") != 0) {
             log("Failed to gather installed software on Windows.");
         }
-        if (system("wmic nic get name, speed") != 0) {
+        if (run("wmic nic get name, speed") != 0) {
             log("Failed to gather network info on Windows.");
         }
     }
 private:
     void log(const string& message) {
-        logMessage("Windows", message);
+        logMessage("Windows", hostTag + message);
+    }
+};
+
+// ----------------------
+// Inventory output
+// ----------------------
+// Prints all sections, or with a snapshot path only those changed since the
+// snapshot (which is then updated). `usage` holds readings that change on
+// every run (free memory, free space); it is always printed and never hashed.
+// Sections named "pkg:..." hold one package each and are listed together
+// under "packages", in a delta as "+ added", "~ changed" or "- removed".
+void printInventory(const vector<InventorySection>& sections, const string& usage, const string& snapshot) {
+    auto isPackage = [](const string& name) { return name.compare(0, 4, "pkg:") == 0; };
+    if (snapshot.empty()) {
+        string packages;
+        for (auto& s : sections) {
+            if (isPackage(s.first)) packages += s.second;
+            else cout << "== " << s.first << " ==\n" << s.second;
+        }
+        if (!packages.empty()) cout << "== packages ==\n" << packages;
+        if (!usage.empty()) cout << "== usage ==\n" << usage;
+        cout << flush;
+        return;
+    }
+    InventorySnapshot snap(snapshot);
+    vector<string> removed;
+    vector<InventorySection> delta = snap.changed(sections, removed);
+    string packages;
+    for (auto& s : delta) {
+        if (isPackage(s.first)) packages += (snap.contains(s.first) ? "~ " : "+ ") + s.second;
+        else cout << "== " << s.first << " ==\n" << s.second;
+    }
+    for (auto& r : removed) {
+        if (isPackage(r)) packages += "- " + r.substr(4) + "\n";
+        else cout << "== " << r << " (removed) ==\n";
+    }
+    if (!packages.empty()) cout << "== packages ==\n" << packages;
+    if (delta.empty() && removed.empty()) cout << "No inventory changes since last snapshot.\n";
+    if (!usage.empty()) cout << "== usage ==\n" << usage;
+    cout << flush;
+    if (!snap.save(sections)) cerr << "Could not write snapshot " << snapshot << endl;
+}
+
+// ----------------------
+// Native system information (Linux)
+// ----------------------
+// Read straight from /proc, /sys and a few syscalls into plain structs, then
+// rendered as named text sections.
+#ifdef __linux__
+struct KernelInfo { string sysname, nodename, release, version, machine; };
+struct OsRelease { string name, version, id; };
+struct CpuInfo {
+    string model;
+    unsigned logical = 0, cores = 0, sockets = 0;
+    double mhz = 0;
+};
+struct MemInfo { uint64_t totalKb = 0, availableKb = 0, freeKb = 0, swapTotalKb = 0, swapFreeKb = 0; };
+struct BlockDevice {
+    string name, model;
+    uint64_t bytes = 0;
+    bool rotational = false, removable = false;
+};
+struct Filesystem {
+    string device, mountpoint, type;
+    uint64_t total = 0, avail = 0;
+};
+struct NetInterface {
+    string name, mac;
+    vector<string> addrs;
+    bool up = false;
+};
+struct PciDevice {
+    string slot, driver;
+    unsigned vendor = 0, device = 0, cls = 0;
+};
+struct SystemInfo {
+    KernelInfo kernel;
+    OsRelease os;
+    CpuInfo cpu;
+    MemInfo mem;
+    vector<BlockDevice> blocks;
+    vector<Filesystem> filesystems;
+    vector<NetInterface> interfaces;
+    vector<PciDevice> pci;
+};
+
+string readFirstLine(const string& path) {
+    ifstream in(path);
+    string line;
+    getline(in, line);
+    return line;
+}
+
+SystemInfo collectSystemInfo() {
+    SystemInfo s;
+    struct utsname u;
+    if (uname(&u) == 0) s.kernel = {u.sysname, u.nodename, u.release, u.version, u.machine};
+
+    ifstream osr("/etc/os-release");
+    for (string line; getline(osr, line);) {
+        size_t eq = line.find('=');
+        if (eq == string::npos) continue;
+        string key = line.substr(0, eq), val = line.substr(eq + 1);
+        if (val.size() >= 2 && val.front() == '"' && val.back() == '"') val = val.substr(1, val.size() - 2);
+        if (key == "NAME") s.os.name = val;
+        else if (key == "VERSION") s.os.version = val;
+        else if (key == "ID") s.os.id = val;
+    }
+
+    // Cores are distinct (physical id, core id) pairs.
+    ifstream cpu("/proc/cpuinfo");
+    vector<pair<int, int>> cores;
+    vector<int> sockets;
+    int phys = 0;
+    for (string line; getline(cpu, line);) {
+        size_t colon = line.find(':');
+        if (colon == string::npos) continue;
+        string key = line.substr(0, line.find_last_not_of(" \t", colon - 1) + 1);
+        string val = colon + 2 <= line.size() ? line.substr(colon + 2) : "";
+        if (key == "processor") ++s.cpu.logical;
+        else if (key == "model name" && s.cpu.model.empty()) s.cpu.model = val;
+        else if (key == "cpu MHz" && s.cpu.mhz == 0) s.cpu.mhz = atof(val.c_str());
+        else if (key == "physical id") { phys = atoi(val.c_str()); if (find(sockets.begin(), sockets.end(), phys) == sockets.end()) sockets.push_back(phys); }
+        else if (key == "core id") { pair<int, int> c{phys, atoi(val.c_str())}; if (find(cores.begin(), cores.end(), c) == cores.end()) cores.push_back(c); }
+    }
+    s.cpu.cores = cores.empty() ? s.cpu.logical : static_cast<unsigned>(cores.size());
+    s.cpu.sockets = sockets.empty() ? 1 : static_cast<unsigned>(sockets.size());
+
+    ifstream mem("/proc/meminfo");
+    for (string key; mem >> key;) {
+        uint64_t kb = 0;
+        mem >> kb;
+        mem.ignore(64, '\n');
+        if (key == "MemTotal:") s.mem.totalKb = kb;
+        else if (key == "MemFree:") s.mem.freeKb = kb;
+        else if (key == "MemAvailable:") s.mem.availableKb = kb;
+        else if (key == "SwapTotal:") s.mem.swapTotalKb = kb;
+        else if (key == "SwapFree:") s.mem.swapFreeKb = kb;
+    }
+
+    // Whole disks only: loop, ram and zram devices are skipped.
+    error_code ec;
+    for (auto& e : filesystem::directory_iterator("/sys/block", ec)) {
+        string name = e.path().filename().string();
+        if (name.rfind("loop", 0) == 0 || name.rfind("ram", 0) == 0 || name.rfind("zram", 0) == 0) continue;
+        string dir = e.path().string();
+        BlockDevice b;
+        b.name = name;
+        b.bytes = strtoull(readFirstLine(dir + "/size").c_str(), nullptr, 10) * 512;   // always 512-byte sectors
+        b.rotational = readFirstLine(dir + "/queue/rotational") == "1";
+        b.removable = readFirstLine(dir + "/removable") == "1";
+        b.model = readFirstLine(dir + "/device/model");
+        while (!b.model.empty() && b.model.back() == ' ') b.model.pop_back();
+        s.blocks.push_back(b);
+    }
+    sort(s.blocks.begin(), s.blocks.end(), [](const BlockDevice& a, const BlockDevice& b) { return a.name < b.name; });
+
+    // Device-backed mounts (what df shows by default), sized with statvfs.
+    ifstream mounts("/proc/self/mounts");
+    for (string line; getline(mounts, line);) {
+        istringstream ls(line);
+        Filesystem f;
+        if (!(ls >> f.device >> f.mountpoint >> f.type) || f.device.empty() || f.device[0] != '/') continue;
+        struct statvfs v;
+        if (statvfs(f.mountpoint.c_str(), &v) != 0) continue;
+        f.total = static_cast<uint64_t>(v.f_blocks) * v.f_frsize;
+        f.avail = static_cast<uint64_t>(v.f_bavail) * v.f_frsize;
+        s.filesystems.push_back(f);
+    }
+
+    struct ifaddrs* ifs = nullptr;
+    if (getifaddrs(&ifs) == 0) {
+        for (struct ifaddrs* a = ifs; a; a = a->ifa_next) {
+            auto it = find_if(s.interfaces.begin(), s.interfaces.end(), [&](const NetInterface& n) { return n.name == a->ifa_name; });
+            if (it == s.interfaces.end()) { s.interfaces.push_back(NetInterface{a->ifa_name, "", {}, false}); it = s.interfaces.end() - 1; }
+            it->up = (a->ifa_flags & IFF_UP) != 0;
+            if (!a->ifa_addr) continue;
+            char buf[INET6_ADDRSTRLEN] = "";
+            int fam = a->ifa_addr->sa_family;
+            if (fam == AF_INET) inet_ntop(fam, &reinterpret_cast<sockaddr_in*>(a->ifa_addr)->sin_addr, buf, sizeof(buf));
+            else if (fam == AF_INET6) inet_ntop(fam, &reinterpret_cast<sockaddr_in6*>(a->ifa_addr)->sin6_addr, buf, sizeof(buf));
+            else if (fam == AF_PACKET) {
+                auto* ll = reinterpret_cast<sockaddr_ll*>(a->ifa_addr);
+                ostringstream mac;
+                for (int i = 0; i < ll->sll_halen; ++i) mac << (i ? ":" : "") << hex << setw(2) << setfill('0') << int(ll->sll_addr[i]);
+                it->mac = mac.str();
+            }
+            if (buf[0]) it->addrs.push_back(buf);
+        }
+        freeifaddrs(ifs);
+    }
+
+    for (auto& e : filesystem::directory_iterator("/sys/bus/pci/devices", ec)) {
+        string dir = e.path().string();
+        PciDevice p;
+        p.slot = e.path().filename().string();
+        p.vendor = static_cast<unsigned>(strtoul(readFirstLine(dir + "/vendor").c_str(), nullptr, 16));
+        p.device = static_cast<unsigned>(strtoul(readFirstLine(dir + "/device").c_str(), nullptr, 16));
+        p.cls = static_cast<unsigned>(strtoul(readFirstLine(dir + "/class").c_str(), nullptr, 16));
+        error_code lec;
+        auto drv = filesystem::read_symlink(dir + "/driver", lec);
+        if (!lec) p.driver = drv.filename().string();
+        s.pci.push_back(p);
+    }
+    sort(s.pci.begin(), s.pci.end(), [](const PciDevice& a, const PciDevice& b) { return a.slot < b.slot; });
+    return s;
+}
+
+string humanBytes(uint64_t n) {
+    const char* unit[] = {"B", "K", "M", "G", "T", "P"};
+    double v = static_cast<double>(n);
+    int u = 0;
+    while (v >= 1024 && u < 5) { v /= 1024; ++u; }
+    ostringstream ss;
+    ss << fixed << setprecision(u ? 1 : 0) << v << unit[u];
+    return ss.str();
+}
+
+const char* pciClassName(unsigned cls) {
+    switch (cls >> 16) {
+    case 0x01: return "storage";
+    case 0x02: return "network";
+    case 0x03: return "display";
+    case 0x04: return "multimedia";
+    case 0x05: return "memory";
+    case 0x06: return "bridge";
+    case 0x07: return "communication";
+    case 0x08: return "system";
+    case 0x0c: return "serial bus";
+    default: return "other";
+    }
+}
+
+// Named text sections, in a fixed order.
+vector<InventorySection> renderSystemInfo(const SystemInfo& s) {
+    vector<InventorySection> out;
+    ostringstream ss;
+    auto take = [&](const char* name) { out.emplace_back(name, ss.str()); ss.str(""); ss.clear(); };
+
+    ss << s.kernel.sysname << " " << s.kernel.release << " " << s.kernel.machine << " (" << s.kernel.nodename << ")\n"
+       << s.kernel.version << "\n";
+    take("kernel");
+    ss << s.os.name << (s.os.version.empty() ? "" : " " + s.os.version) << " [" << s.os.id << "]\n";
+    take("os");
+    ss << s.cpu.model << "\n" << s.cpu.sockets << " socket(s), " << s.cpu.cores << " core(s), "
+       << s.cpu.logical << " thread(s)\n";
+    take("cpu");
+    ss << "Memory: " << humanBytes(s.mem.totalKb * 1024) << " total\n"
+       << "Swap:   " << humanBytes(s.mem.swapTotalKb * 1024) << " total\n";
+    take("memory");
+    for (auto& b : s.blocks)
+        ss << left << setw(10) << b.name << right << setw(8) << humanBytes(b.bytes) << (b.rotational ? "  hdd" : "  ssd")
+           << (b.removable ? " removable" : "") << (b.model.empty() ? "" : "  " + b.model) << "\n";
+    take("disks");
+    for (auto& f : s.filesystems)
+        ss << left << setw(20) << f.device << " " << setw(20) << f.mountpoint << " " << setw(6) << f.type << right
+           << setw(8) << humanBytes(f.total) << "\n";
+    take("filesystems");
+    for (auto& n : s.interfaces) {
+        ss << n.name << (n.up ? " up" : " down") << (n.mac.empty() ? "" : " " + n.mac);
+        for (auto& a : n.addrs) ss << " " << a;
+        ss << "\n";
+    }
+    take("network");
+    for (auto& p : s.pci) {
+        ss << p.slot << " " << pciClassName(p.cls) << " " << hex << setfill('0') << setw(4) << p.vendor << ":" << setw(4) << p.device
+           << dec << setfill(' ') << (p.driver.empty() ? "" : " (" + p.driver + ")") << "\n";
+    }
+    take("pci");
+    return out;
+}
+
+// Free memory and free space, kept out of the sections above so a snapshot
+// only reports real configuration changes.
+string renderUsage(const SystemInfo& s) {
+    ostringstream ss;
+    ss << "Memory: " << humanBytes(s.mem.availableKb * 1024) << " available\n"
+       << "Swap:   " << humanBytes(s.mem.swapFreeKb * 1024) << " free\n";
+    for (auto& f : s.filesystems)
+        ss << left << setw(20) << f.mountpoint << right << setw(8) << humanBytes(f.avail) << " avail\n";
+    return ss.str();
+}
+#endif
+
+// ----------------------
+// Package database
+// ----------------------
+#ifdef __linux__
+// Installed packages read straight from the package manager's database. dpkg's
+// status file and pacman's local/*/desc files are mapped and parsed in place,
+// so names and versions are views into the mappings. rpm keeps its database in
+// sqlite or Berkeley DB, so there the list comes from a single `rpm -qa`.
+struct Package {
+    string_view name, version, arch;
+};
+
+enum class VersionScheme { Dpkg, Rpm };   // pacman orders versions like rpm
+
+// dpkg's verrevcmp: non-digit runs compare with '~' lowest, then letters, then
+// other characters; digit runs compare numerically.
+int dpkgSegmentCompare(string_view a, string_view b) {
+    auto at = [](string_view s, size_t i) { return i < s.size() ? s[i] : '\0'; };
+    auto order = [](char c) {
+        if (isdigit(static_cast<unsigned char>(c))) return 0;
+        if (isalpha(static_cast<unsigned char>(c))) return int(c);
+        if (c == '~') return -1;
+        return c ? int(static_cast<unsigned char>(c)) + 256 : 0;
+    };
+    size_t i = 0, j = 0;
+    while (i < a.size() || j < b.size()) {
+        while ((i < a.size() && !isdigit(static_cast<unsigned char>(a[i]))) ||
+               (j < b.size() && !isdigit(static_cast<unsigned char>(b[j])))) {
+            int ac = order(at(a, i)), bc = order(at(b, j));
+            if (ac != bc) return ac - bc;
+            ++i; ++j;
+        }
+        while (at(a, i) == '0') ++i;
+        while (at(b, j) == '0') ++j;
+        int firstDiff = 0;
+        while (isdigit(static_cast<unsigned char>(at(a, i))) && isdigit(static_cast<unsigned char>(at(b, j)))) {
+            if (!firstDiff) firstDiff = at(a, i) - at(b, j);
+            ++i; ++j;
+        }
+        if (isdigit(static_cast<unsigned char>(at(a, i)))) return 1;
+        if (isdigit(static_cast<unsigned char>(at(b, j)))) return -1;
+        if (firstDiff) return firstDiff;
+    }
+    return 0;
+}
+
+// rpmvercmp: alphanumeric segments, numbers beat letters, '~' sorts first.
+int rpmSegmentCompare(string_view a, string_view b) {
+    if (a == b) return 0;
+    auto alnum = [](char c) { return isalnum(static_cast<unsigned char>(c)) != 0; };
+    auto digit = [](char c) { return isdigit(static_cast<unsigned char>(c)) != 0; };
+    size_t i = 0, j = 0;
+    while (i < a.size() || j < b.size()) {
+        while (i < a.size() && !alnum(a[i]) && a[i] != '~') ++i;
+        while (j < b.size() && !alnum(b[j]) && b[j] != '~') ++j;
+        bool ta = i < a.size() && a[i] == '~', tb = j < b.size() && b[j] == '~';
+        if (ta || tb) {
+            if (!ta) return 1;
+            if (!tb) return -1;
+            ++i; ++j;
+            continue;
+        }
+        if (i >= a.size() || j >= b.size()) break;
+        bool num = digit(a[i]);
+        size_t si = i, sj = j;
+        while (i < a.size() && (num ? digit(a[i]) : isalpha(static_cast<unsigned char>(a[i])))) ++i;
+        while (j < b.size() && (num ? digit(b[j]) : isalpha(static_cast<unsigned char>(b[j])))) ++j;
+        if (j == sj) return num ? 1 : -1;
+        string_view x = a.substr(si, i - si), y = b.substr(sj, j - sj);
+        if (num) {
+            x.remove_prefix(min(x.find_first_not_of('0'), x.size()));
+            y.remove_prefix(min(y.find_first_not_of('0'), y.size()));
+            if (x.size() != y.size()) return x.size() < y.size() ? -1 : 1;
+        }
+        int rc = x.compare(y);
+        if (rc) return rc < 0 ? -1 : 1;
+    }
+    if (i >= a.size() && j >= b.size()) return 0;
+    return i < a.size() ? 1 : -1;
+}
+
+// [epoch:]version[-revision]; epochs compare first, then versions, then
+// revisions (rpm/pacman only when both sides have one).
+int compareVersions(string_view a, string_view b, VersionScheme scheme) {
+    auto split = [](string_view v, string_view& epoch, string_view& ver, string_view& rev) {
+        size_t colon = v.find(':');
+        epoch = colon == string_view::npos ? "0" : v.substr(0, colon);
+        ver = colon == string_view::npos ? v : v.substr(colon + 1);
+        size_t dash = ver.rfind('-');
+        rev = dash == string_view::npos ? "" : ver.substr(dash + 1);
+        if (dash != string_view::npos) ver = ver.substr(0, dash);
+    };
+    string_view ea, va, ra, eb, vb, rb;
+    split(a, ea, va, ra);
+    split(b, eb, vb, rb);
+    auto cmp = scheme == VersionScheme::Dpkg ? dpkgSegmentCompare : rpmSegmentCompare;
+    int rc = cmp(ea, eb);
+    if (!rc) rc = cmp(va, vb);
+    if (!rc && (scheme == VersionScheme::Dpkg || (!ra.empty() && !rb.empty()))) rc = cmp(ra, rb);
+    return rc < 0 ? -1 : rc > 0 ? 1 : 0;
+}
+
+class PackageDb {
+public:
+    // Tries dpkg, then pacman, then rpm; false if none has any packages.
+    bool load() {
+        if (loadDpkg("/var/lib/dpkg/status")) src = "dpkg";
+        else if (loadPacman("/var/lib/pacman/local")) { src = "pacman"; scheme = VersionScheme::Rpm; }
+        else if (loadRpm()) { src = "rpm"; scheme = VersionScheme::Rpm; }
+        else return false;
+        sort(pkgs.begin(), pkgs.end(), [](const Package& x, const Package& y) {
+            return x.name != y.name ? x.name < y.name : x.arch < y.arch;
+        });
+        return true;
+    }
+
+    const string& source() const { return src; }
+    const vector<Package>& packages() const { return pkgs; }
+
+    // First entry named `name` (another architecture may follow it).
+    const Package* find(string_view name) const {
+        auto it = lower_bound(pkgs.begin(), pkgs.end(), name, [](const Package& p, string_view n) { return p.name < n; });
+        return it != pkgs.end() && it->name == name ? &*it : nullptr;
     }
+
+    static bool knownOp(const string& op) {
+        return op == "<" || op == "<=" || op == "=" || op == ">=" || op == ">" || op == "<<" || op == ">>";
+    }
+    // Whether `name` is installed with a version that is `op` `version`.
+    bool satisfies(string_view name, const string& op, string_view version) const {
+        const Package* p = find(name);
+        if (!p) return false;
+        int c = compareVersions(p->version, version, scheme);
+        if (op == "<" || op == "<<") return c < 0;
+        if (op == "<=") return c <= 0;
+        if (op == "=") return c == 0;
+        if (op == ">=") return c >= 0;
+        if (op == ">" || op == ">>") return c > 0;
+        return false;
+    }
+
+    // "name version arch" per line, sorted by name.
+    // One inventory section per package, named "pkg:name[:arch]", so a
+    // snapshot records each package's version separately.
+    void render(vector<InventorySection>& out) const {
+        for (auto& p : pkgs) {
+            string name = "pkg:";
+            name.append(p.name);
+            if (!p.arch.empty()) name.append(":").append(p.arch);
+            string line(p.name);
+            line.append(" ").append(p.version);
+            if (!p.arch.empty()) line.append(" ").append(p.arch);
+            out.emplace_back(move(name), line + "\n");
+        }
+    }
+
+private:
+    // Stanzas separated by blank lines; continuation lines start with a space.
+    bool loadDpkg(const string& path) {
+        auto m = make_unique<MappedFile>(path);
+        if (!m->ok) return false;
+        string_view text(m->ptr, m->len);
+        Package cur;
+        bool installed = false;
+        size_t pos = 0;
+        while (pos <= text.size()) {
+            size_t eol = text.find('\n', pos);
+            if (eol == string_view::npos) eol = text.size();
+            string_view line = text.substr(pos, eol - pos);
+            pos = eol + 1;
+            if (line.empty()) {
+                if (installed && !cur.name.empty()) pkgs.push_back(cur);
+                cur = Package();
+                installed = false;
+                continue;
+            }
+            if (line[0] == ' ') continue;
+            size_t colon = line.find(':');
+            if (colon == string_view::npos) continue;
+            string_view key = line.substr(0, colon), val = line.substr(colon + 1);
+            if (!val.empty() && val[0] == ' ') val.remove_prefix(1);
+            if (key == "Package") cur.name = val;
+            else if (key == "Version") cur.version = val;
+            else if (key == "Architecture") cur.arch = val;
+            else if (key == "Status") installed = val.size() >= 10 && val.substr(val.size() - 10) == " installed";
+        }
+        if (installed && !cur.name.empty()) pkgs.push_back(cur);
+        maps.push_back(move(m));
+        return !pkgs.empty();
+    }
+
+    // One directory per package; desc holds "%FIELD%" lines each followed by
+    // the value.
+    bool loadPacman(const string& dir) {
+        error_code ec;
+        for (auto& e : filesystem::directory_iterator(dir, ec)) {
+            auto m = make_unique<MappedFile>((e.path() / "desc").string());
+            if (!m->ok) continue;
+            string_view text(m->ptr, m->len);
+            auto field = [&](string_view key) {
+                size_t at = 0;
+                while ((at = text.find(key, at)) != string_view::npos && at != 0 && text[at - 1] != '\n') at += key.size();
+                if (at == string_view::npos) return string_view();
+                size_t start = at + key.size(), eol = text.find('\n', start);
+                return text.substr(start, eol == string_view::npos ? string_view::npos : eol - start);
+            };
+            Package p{field("%NAME%\n"), field("%VERSION%\n"), field("%ARCH%\n")};
+            if (p.name.empty()) continue;
+            pkgs.push_back(p);
+            maps.push_back(move(m));
+        }
+        return !pkgs.empty();
+    }
+
+    bool loadRpm() {
+        if (!commandExists("rpm")) return false;
+        FILE* p = popen("rpm -qa --qf '%{NAME} %|EPOCH?{%{EPOCH}:}|%{VERSION}-%{RELEASE} %{ARCH}\\n' 2>/dev/null", "r");
+        if (!p) return false;
+        char buf[65536];
+        for (size_t n; (n = fread(buf, 1, sizeof(buf), p)) > 0;) owned.append(buf, n);
+        pclose(p);
+        // Views are taken only once `owned` has stopped growing.
+        string_view text(owned);
+        for (size_t pos = 0; pos < text.size();) {
+            size_t eol = text.find('\n', pos);
+            if (eol == string_view::npos) eol = text.size();
+            string_view line = text.substr(pos, eol - pos);
+            pos = eol + 1;
+            size_t s1 = line.find(' '), s2 = line.rfind(' ');
+            if (s1 == string_view::npos || s2 == s1) continue;
+            pkgs.push_back({line.substr(0, s1), line.substr(s1 + 1, s2 - s1 - 1), line.substr(s2 + 1)});
+        }
+        return !pkgs.empty();
+    }
+
+    vector<unique_ptr<MappedFile>> maps;
+    string owned;
+    vector<Package> pkgs;
+    string src;
+    VersionScheme scheme = VersionScheme::Dpkg;
 };
+#endif
 
 class LinuxUpdater : public OSUpdater {
 private:
     string distro;
 public:
-    LinuxUpdater(const string& distroType) : distro(distroType) {}
+    // os-release calls Mint "Linux Mint".
+    LinuxUpdater(const string& distroType) : distro(distroType == "Linux Mint" ? "Mint" : distroType) {}
     void checkForUpdates() override {
         log("Checking for updates on " + distro + "...");
         if (distro == "Ubuntu" || distro == "Debian" || distro == "Mint") {
-            if (!commandExists("apt-get")) {
+            if (!require("apt-get")) {
                 log("apt-get command not found, skipping update.");
                 return;
             }
-            if (system("sudo apt-get update") != 0) {
+            if (run("sudo apt-get update") != 0) {
                 log("Failed to update on " + distro);
             }
         } else if (distro == "RedHat" || distro == "CentOS" || distro == "Fedora") {
-            if (!commandExists("dnf")) {
+            if (!require("dnf")) {
                 log("dnf command not found, skipping update.");
                 return;
             }
-            if (system("sudo dnf check-update") != 0) {
+            if (run("sudo dnf check-update", {0, 100}) != 0) {
                 log("Failed to check for updates on " + distro);
             }
         } else if (distro == "Arch") {
-            if (!commandExists("pacman")) {
+            if (!require("pacman")) {
                 log("pacman command not found, skipping update.");
                 return;
             }
-            if (system("sudo pacman -Sy --noconfirm") != 0) {
+            if (run("sudo pacman -Sy --noconfirm") != 0) {
                 log("Failed to check for updates on " + distro);
             }
         } else {
+            markFailed();
             log("Unsupported Linux distribution detected for updates.");
         }
     }
     void performUpdate() override {
         log("Performing update on " + distro + "...");
         if (distro == "Ubuntu" || distro == "Debian" || distro == "Mint") {
-            if (!commandExists("apt-get")) {
+            if (!require("apt-get")) {
                 log("apt-get command not found, skipping update.");
                 return;
             }
-            if (system("sudo apt-get upgrade -y") != 0) {
+            if (run("sudo apt-get upgrade -y") != 0) {
                 log("Failed to upgrade on " + distro);
             }
         } else if (distro == "RedHat" || distro == "CentOS" || distro == "Fedora") {
-            if (!commandExists("dnf")) {
+            if (!require("dnf")) {
                 log("dnf command not found, skipping update.");
                 return;
             }
-            if (system("sudo dnf upgrade -y") != 0) {
+            if (run("sudo dnf upgrade -y") != 0) {
                 log("Failed to upgrade on " + distro);
             }
         } else if (distro == "Arch") {
-            if (!commandExists("pacman")) {
+            if (!require("pacman")) {
                 log("pacman command not found, skipping update.");
                 return;
             }
-            if (system("sudo pacman -Syu --noconfirm") != 0) {
+            if (run("sudo pacman -Syu --noconfirm") != 0) {
                 log("Failed to upgrade on " + distro);
             }
         } else {
+            markFailed();
             log("Unsupported Linux distribution detected for updates.");
         }
     }
     void handleDependencies() override {
         log("Handling dependencies on " + distro + "...");
         if (distro == "Ubuntu" || distro == "Debian" || distro == "Mint") {
-            if (!commandExists("apt-get")) {
+            if (!require("apt-get")) {
                 log("apt-get command not found, skipping dependency handling.");
                 return;
             }
-            if (system("sudo apt-get dist-upgrade -y") != 0) {
+            if (run("sudo apt-get dist-upgrade -y") != 0) {
                 log("Failed to handle dependencies on " + distro);
             }
         } else if (distro == "RedHat" || distro == "CentOS" || distro == "Fedora") {
-            if (!commandExists("dnf")) {
+            if (!require("dnf")) {
                 log("dnf command not found, skipping dependency handling.");
                 return;
             }
-            if (system("sudo dnf distro-sync -y") != 0) {
+            if (run("sudo dnf distro-sync -y") != 0) {
                 log("Failed to handle dependencies on " + distro);
             }
         } else if (distro == "Arch") {
-            if (!commandExists("pacman")) {
+            if (!require("pacman")) {
                 log("pacman command not found, skipping dependency handling.");
                 return;
             }
-            if (system("sudo pacman -S archlinux-keyring --noconfirm") != 0) {
+            if (run("sudo pacman -S archlinux-keyring --noconfirm") != 0) {
                 log("Failed to handle dependencies on " + distro);
             }
         } else {
+            markFailed();
             log("Unsupported Linux distribution detected for dependency handling.");
         }
     }
     void updateFirmware() override {
         log("Updating firmware on " + distro + "...");
-        if (!commandExists("fwupdmgr")) {
+        if (!require("fwupdmgr")) {
             log("fwupdmgr not found, skipping firmware update.");
             return;
         }
-        if (system("fwupdmgr refresh") != 0) {
+        if (run("fwupdmgr refresh", {0, 2}) != 0) {
             log("Failed to refresh firmware on " + distro);
         }
-        if (system("fwupdmgr update") != 0) {
+        if (run("fwupdmgr update", {0, 2}) != 0) {
             log("Failed to update firmware on " + distro);
         }
     }
     void updateCache() override {
         log("Updating cache on " + distro + "...");
         if (distro == "Ubuntu" || distro == "Debian" || distro == "Mint") {
-            if (!commandExists("apt-get")) {
+            if (!require("apt-get")) {
                 log("apt-get command not found, skipping cache update.");
                 return;
             }
-            if (system("sudo apt-get update") != 0) {
+            if (run("sudo apt-get update") != 0) {
                 log("Failed to update cache on " + distro);
             }
         } else if (distro == "RedHat" || distro == "CentOS" || distro == "Fedora") {
-            if (!commandExists("dnf")) {
+            if (!require("dnf")) {
                 log("dnf command not found, skipping cache update.");
                 return;
             }
-            if (system("sudo dnf makecache") != 0) {
+            if (run("sudo dnf makecache") != 0) {
                 log("Failed to update cache on " + distro);
             }
         } else if (distro == "Arch") {
-            if (!commandExists("pacman")) {
+            if (!require("pacman")) {
                 log("pacman command not found, skipping cache update.");
                 return;
             }
-            if (system("sudo pacman -Sy --noconfirm") != 0) {
+            if (run("sudo pacman -Sy --noconfirm") != 0) {
                 log("Failed to update cache on " + distro);
             }
+        } else {
+            markFailed();
+            log("Unsupported Linux distribution detected for cache update.");
         }
     }
+    // Hardware, OS details and installed packages are read in process; the
+    // package tool is only run when no package database could be read.
     void gatherSystemInfo() override {
         log("Gathering system information for " + distro + "...");
-        if (system("uname -r") != 0) {
-            log("Failed to gather kernel version on " + distro);
-        }
-        if (system("lscpu") != 0) {
-            log("Failed to gather CPU info on " + distro);
-        }
-        if (system("free -h") != 0) {
-            log("Failed to gather memory info on " + distro);
-        }
-        if (system("lsblk") != 0) {
-            log("Failed to gather disk details on " + distro);
-        }
-        if (system("df -h") != 0) {
-            log("Failed to gather disk usage on " + distro);
+        bool packagesListed = false;
+#ifdef __linux__
+        if (local()) {
+            auto t0 = chrono::steady_clock::now();
+            SystemInfo info = collectSystemInfo();
+            vector<InventorySection> sections = renderSystemInfo(info);
+            PackageDb packages;
+            if (packages.load()) {
+                packages.render(sections);
+                packagesListed = true;
+            }
+            printInventory(sections, renderUsage(info), snapshotPath);
+            ostringstream ss;
+            ss << fixed << setprecision(1) << "Collected system information";
+            if (packagesListed) ss << " and " << packages.packages().size() << " " << packages.source() << " packages";
+            ss << " in " << chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count() << " ms";
+            log(ss.str());
+        } else
+#endif
+        {
+            // Remote hosts are still inspected through their own tools.
+            const pair<const char*, const char*> probes[] = {
+                {"uname -r", "kernel version"}, {"lscpu", "CPU info"}, {"free -h", "memory info"},
+                {"lsblk", "disk details"}, {"df -h", "disk usage"}, {"ifconfig -a", "network info"},
+                {"lspci", "hardware info"}, {"cat /etc/os-release", "OS version"}};
+            for (auto& p : probes)
+                if (run(p.first) != 0) log(string("Failed to gather ") + p.second + " on " + distro);
         }
-        if (system("fwupdmgr get-devices") != 0) {
+        if (has("fwupdmgr") && run("fwupdmgr get-devices", {0, 2}) != 0) {
             log("Failed to gather firmware info on " + distro);
         }
-        if (system("dpkg -l") != 0) {
-            log("Failed to list installed packages (Debian-based) on " + distro);
-        }
-        if (system("rpm -qa") != 0) {
-            log("Failed to list installed packages (RedHat-based) on " + distro);
-        }
-        if (system("pacman -Q") != 0) {
-            log("Failed to list installed packages (Arch-based) on " + distro);
+        if (packagesListed) return;
+        if (has("dpkg")) {
+            if (run("dpkg -l") != 0) log("Failed to list installed packages (Debian-based) on " + distro);
+        } else if (has("rpm")) {
+            if (run("rpm -qa") != 0) log("Failed to list installed packages (RedHat-based) on " + distro);
+        } else if (has("pacman")) {
+            if (run("pacman -Q") != 0) log("Failed to list installed packages (Arch-based) on " + distro);
+        } else {
+            log("No known package manager found on " + distro);
         }
-        if (system("ifconfig -a") != 0) {
-            log("Failed to gather network info on " + distro);
+    }
+private:
+    void log(const string& message) {
+        logMessage("Linux", hostTag + message);
+    }
+};
+
+// ----------------------
+// Task graph
+// ----------------------
+// Runs named steps as soon as their dependencies finish, one worker thread per
+// step that can run at once. A step that returns false or throws is logged
+// as failed and its dependents are skipped. Afterwards report() logs each step's start offset
+// and wall time and the critical path (the chain of steps that bounded the
+// total time).
+class TaskGraph {
+public:
+    size_t add(const string& name, function<bool()> fn, vector<size_t> deps = {}) {
+        tasks.push_back(Task{name, move(fn), move(deps), {}, 0, 0.0, 0.0, State::Pending});
+        for (size_t d : tasks.back().deps) tasks[d].dependents.push_back(tasks.size() - 1);
+        tasks.back().waiting = tasks.back().deps.size();
+        return tasks.size() - 1;
+    }
+
+    void run(size_t workers) {
+        t0 = chrono::steady_clock::now();
+        for (size_t i = 0; i < tasks.size(); ++i) if (!tasks[i].waiting) ready.push_back(i);
+        remaining = tasks.size();
+        vector<thread> pool;
+        for (size_t w = 0; w < max<size_t>(workers, 1); ++w) pool.emplace_back([this] { work(); });
+        for (auto& t : pool) t.join();
+        wall = elapsed();
+    }
+
+    // Called with (step, true) when a step starts and (step, false) when it ends.
+    function<void(const string&, bool)> onStep;
+
+    // prefix is put in front of every timing line (e.g. a host tag).
+    void report(const string& prefix = "") const {
+        for (const Task& t : tasks) {
+            ostringstream ss;
+            ss << fixed << setprecision(2) << prefix << t.name << ": "
+               << (t.state == State::Done ? "done" : t.state == State::Failed ? "failed" : "skipped")
+               << ", start +" << t.start << "s, " << t.secs << "s";
+            logMessage("Timing", ss.str());
         }
-        if (system("lspci") != 0) {
-            log("Failed to gather hardware info on " + distro);
+        // Longest chain by finish time: follow the dependency that finished last.
+        size_t end = 0;
+        for (size_t i = 1; i < tasks.size(); ++i)
+            if (tasks[i].start + tasks[i].secs > tasks[end].start + tasks[end].secs) end = i;
+        vector<size_t> path;
+        for (size_t cur = end; !tasks.empty();) {
+            path.push_back(cur);
+            const Task& t = tasks[cur];
+            if (t.deps.empty()) break;
+            cur = *max_element(t.deps.begin(), t.deps.end(), [&](size_t a, size_t b) {
+                return tasks[a].start + tasks[a].secs < tasks[b].start + tasks[b].secs;
+            });
         }
-        if (system("cat /etc/os-release") != 0) {
-            log("Failed to gather OS version on " + distro);
+        ostringstream ss;
+        ss << fixed << setprecision(2) << prefix << "Critical path: ";
+        double sum = 0;
+        for (auto it = path.rbegin(); it != path.rend(); ++it) {
+            ss << (it == path.rbegin() ? "" : " -> ") << tasks[*it].name;
+            sum += tasks[*it].secs;
         }
+        ss << " (" << sum << "s of " << wall << "s wall)";
+        logMessage("Timing", ss.str());
     }
+
 private:
-    void log(const string& message) {
-        logMessage("Linux", message);
+    enum class State { Pending, Done, Failed, Skipped };
+    struct Task {
+        string name;
+        function<bool()> fn;
+        vector<size_t> deps, dependents;
+        size_t waiting;
+        double start, secs;
+        State state;
+    };
+    vector<Task> tasks;
+    deque<size_t> ready;
+    size_t remaining = 0;
+    mutex m;
+    condition_variable cv;
+    chrono::steady_clock::time_point t0;
+    double wall = 0.0;
+
+    double elapsed() const { return chrono::duration<double>(chrono::steady_clock::now() - t0).count(); }
+
+    void work() {
+        unique_lock<mutex> lock(m);
+        for (;;) {
+            cv.wait(lock, [this] { return !ready.empty() || remaining == 0; });
+            if (remaining == 0) return;
+            size_t i = ready.front();
+            ready.pop_front();
+            Task& t = tasks[i];
+            bool skip = any_of(t.deps.begin(), t.deps.end(), [&](size_t d) { return tasks[d].state != State::Done; });
+            t.start = elapsed();
+            lock.unlock();
+            State result = State::Skipped;
+            if (skip) {
+                logMessage("Error", "Skipping " + t.name + ": a step it depends on did not finish.");
+            } else {
+                if (onStep) onStep(t.name, true);
+                try { result = t.fn() ? State::Done : State::Failed; }
+                catch (const exception& e) {
+                    logMessage("Error", "Error during update: " + string(e.what()));
+                    result = State::Failed;
+                }
+                if (onStep) onStep(t.name, false);
+            }
+            double end = elapsed();
+            lock.lock();
+            t.secs = end - t.start;
+            t.state = result;
+            for (size_t d : t.dependents) if (--tasks[d].waiting == 0) ready.push_back(d);
+            --remaining;
+            cv.notify_all();
+        }
     }
 };
 
@@ -377,38 +1199,192 @@ public:
             }
         }
 
-        if (osType == "macOS") {
-            updater = make_unique<OSXUpdater>();
-        } else if (osType == "Windows") {
-            updater = make_unique<WindowsUpdater>();
-        } else if (osType == "Ubuntu" || osType == "Debian" || osType == "Linux Mint" ||
-                   osType == "RedHat" || osType == "CentOS" || osType == "Fedora" || osType == "Arch") {
-            updater = make_unique<LinuxUpdater>(osType);
-        } else {
+        updater = makeUpdater(osType);
+        if (!updater) {
             logMessage("Error", "Unsupported OS detected.");
             return;
         }
         logMessage("OS Detected", "OS detected: " + osType);
     }
 
+    // nullptr for an OS name no updater handles.
+    static unique_ptr<OSUpdater> makeUpdater(const string& osType) {
+        if (osType == "macOS") return make_unique<OSXUpdater>();
+        if (osType == "Windows") return make_unique<WindowsUpdater>();
+        if (osType == "Ubuntu" || osType == "Debian" || osType == "Linux Mint" ||
+            osType == "RedHat" || osType == "CentOS" || osType == "Fedora" || osType == "Arch")
+            return make_unique<LinuxUpdater>(osType);
+        return nullptr;
+    }
+
+    // The package-manager steps form a chain; firmware only waits for it
+    // when it shares the package tool (macOS softwareupdate).
+    // A step fails when any of its commands failed or it was skipped.
+    static void runSteps(OSUpdater& u, const string& host = "", function<void(const string&, bool)> onStep = nullptr) {
+        TaskGraph g;
+        g.onStep = move(onStep);
+        auto step = [&u](void (OSUpdater::*fn)()) {
+            return [&u, fn] {
+                size_t before = OSUpdater::threadFailures();
+                (u.*fn)();
+                return OSUpdater::threadFailures() == before;
+            };
+        };
+        size_t cache = g.add("updateCache", step(&OSUpdater::updateCache));
+        size_t check = g.add("checkForUpdates", step(&OSUpdater::checkForUpdates), {cache});
+        size_t perform = g.add("performUpdate", step(&OSUpdater::performUpdate), {check});
+        size_t deps = g.add("handleDependencies", step(&OSUpdater::handleDependencies), {perform});
+        vector<size_t> fwDeps;
+        if (u.firmwareUsesPackageTool()) fwDeps.push_back(deps);
+        g.add("updateFirmware", step(&OSUpdater::updateFirmware), fwDeps);
+        g.run(2);
+        g.report(host.empty() ? "" : "[" + host + "] ");
+    }
+
     void performUpdate() {
+        if (updater) runSteps(*updater);
+    }
+
+    void gatherSystemInfo(const string& snapshot = "") {
         if (updater) {
-            try {
-                updater->updateCache();
-                updater->checkForUpdates();
-                updater->performUpdate();
-                updater->handleDependencies();
-                updater->updateFirmware();
-            } catch (const exception& e) {
-                logMessage("Error", "Error during update: " + string(e.what()));
+            updater->setSnapshot(snapshot);
+            updater->gatherSystemInfo();
+        }
+    }
+};
+
+// ----------------------
+// Fleet mode
+// ----------------------
+// Inventory lines: name transport address os, e.g.
+//   web1  ssh    admin@10.0.0.5  Ubuntu
+//   lab1  local  /srv/lab1       Fedora
+// ("local" runs from the address directory; '#' starts a comment.)
+struct FleetHost {
+    string name, transport, address, os;
+};
+
+bool loadInventory(const string& path, vector<FleetHost>& hosts) {
+    ifstream in(path);
+    if (!in) { cerr << "Inventory not found: " << path << endl; return false; }
+    string line;
+    for (int n = 1; getline(in, line); ++n) {
+        if (line.find('#') != string::npos) line.erase(line.find('#'));
+        istringstream ls(line);
+        FleetHost h;
+        if (!(ls >> h.name)) continue;
+        getline(ls >> h.transport >> h.address >> ws, h.os);
+        while (!h.os.empty() && isspace(static_cast<unsigned char>(h.os.back()))) h.os.pop_back();
+        if (h.os.empty() || (h.transport != "local" && h.transport != "ssh")) {
+            cerr << path << ":" << n << ": expected 'name local|ssh address os'" << endl;
+            return false;
+        }
+        hosts.push_back(h);
+    }
+    return true;
+}
+
+// Runs the update steps on every host, at most `parallel` at a time, batch by
+// batch (each batch finishes before the next starts). Once more than
+// maxFailures hosts have failed no further host is started. A host fails
+// when it cannot be reached, any of its commands exits non-zero, a step is
+// skipped for a missing tool, or its OS is unsupported. Command
+// output goes to fleet_logs/<name>.out; a progress line is printed every
+// couple of seconds and whenever a host finishes.
+class Fleet {
+public:
+    Fleet(vector<FleetHost> hosts, size_t parallel, size_t batch, size_t maxFailures)
+        : hosts(move(hosts)), parallel(max<size_t>(parallel, 1)),
+          batch(batch ? batch : this->hosts.size()), maxFailures(maxFailures) {}
+
+    int run() {
+        error_code ec;
+        filesystem::create_directories("fleet_logs", ec);
+        auto t0 = chrono::steady_clock::now();
+        thread ticker([this] {
+            unique_lock<mutex> lock(m);
+            while (!finished) {
+                if (cv.wait_for(lock, chrono::seconds(2), [this] { return finished; })) break;
+                printProgress(lock);
             }
+        });
+        for (size_t first = 0; first < hosts.size() && !aborted(); first += batch) {
+            size_t last = min(hosts.size(), first + batch);
+            atomic<size_t> next{first};
+            vector<thread> workers;
+            for (size_t w = 0; w < min(parallel, last - first); ++w)
+                workers.emplace_back([&] {
+                    for (size_t i; !aborted() && (i = next++) < last;) runHost(hosts[i]);
+                });
+            for (auto& t : workers) t.join();
+        }
+        {
+            lock_guard<mutex> lock(m);
+            finished = true;
         }
+        cv.notify_all();
+        ticker.join();
+        double secs = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+        ostringstream ss;
+        ss << fixed << setprecision(1) << "Fleet finished in " << secs << "s: " << done << " updated, "
+           << failed << " failed, " << hosts.size() - done - failed << " not run" << (aborted() ? " (stopped: too many failures)" : "");
+        logMessage("Fleet", ss.str());
+        cout << ss.str() << endl;
+        return failed ? 1 : 0;
     }
 
-    void gatherSystemInfo() {
-        if (updater) {
-            updater->gatherSystemInfo();
+private:
+    vector<FleetHost> hosts;
+    size_t parallel, batch, maxFailures;
+    mutex m;
+    condition_variable cv;
+    bool finished = false;
+    size_t done = 0, failed = 0, running = 0;
+    map<string, size_t> inStep;                         // step -> hosts currently in it
+
+    bool aborted() {
+        lock_guard<mutex> lock(m);
+        return failed > maxFailures;
+    }
+
+    void runHost(const FleetHost& h) {
+        {
+            lock_guard<mutex> lock(m);
+            ++running;
+        }
+        unique_ptr<Transport> t;
+        if (h.transport == "ssh") t = make_unique<SshTransport>(h.address);
+        else t = make_unique<LocalTransport>(h.address);
+        t->setOutput("fleet_logs/" + h.name + ".out");
+        unique_ptr<OSUpdater> u = UpdaterManager::makeUpdater(h.os);
+        bool ok = false;
+        if (!u) {
+            logMessage("Error", "[" + h.name + "] Unsupported OS: " + h.os);
+        } else if (!t->reachable()) {
+            logMessage("Error", "[" + h.name + "] Host unreachable: " + h.address);
+        } else {
+            u->setTransport(*t, h.name);
+            UpdaterManager::runSteps(*u, h.name, [this](const string& step, bool started) {
+                lock_guard<mutex> lock(m);
+                if (started) ++inStep[step];
+                else if (--inStep[step] == 0) inStep.erase(step);
+            });
+            ok = u->failures() == 0;
         }
+        logMessage("Fleet", "[" + h.name + "] " + (ok ? "updated" : "failed"));
+        unique_lock<mutex> lock(m);
+        --running;
+        ++(ok ? done : failed);
+        printProgress(lock);
+    }
+
+    void printProgress(unique_lock<mutex>&) {
+        ostringstream ss;
+        ss << "[fleet] " << done + failed << "/" << hosts.size() << " finished (" << failed << " failed), "
+           << running << " running";
+        const char* sep = ": ";
+        for (auto& s : inStep) { ss << sep << s.first << " " << s.second; sep = ", "; }
+        cout << ss.str() << endl;
     }
 };
 
@@ -416,20 +1392,88 @@ public:
 // Main with argv options
 // ----------------------
 int main(int argc, char* argv[]) {
-    if (argc > 1) {
-        string arg = argv[1];
+    AsyncLogger::instance().open("update_log.txt");
+    string snapshot;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
         if (arg == "--h" || arg == "--help") {
             cout << "Usage: updater [options]\n"
                  << "Options:\n"
                  << "  --h, --help   Show this help message\n"
+                 << "  --binlog      Also write update_log.bin/.idx (binary log)\n"
+                 << "  --readlog [base] [-c category] [--since T] [--until T]\n"
+                 << "                Print a binary log (default base update_log); T is epoch\n"
+                 << "                seconds, YYYY-MM-DD or \"YYYY-MM-DD HH:MM:SS\"\n"
+                 << "  --delta [file] Print only the system info sections changed since the\n"
+                 << "                last run (snapshot file, default inventory.snap)\n"
+                 << "  --pkgcheck name op version\n"
+                 << "                Exit 0 if the installed package satisfies op version\n"
+                 << "                (op is <, <=, =, >=, >), 1 if not or not installed\n"
+                 << "  --fleet inventory [--parallel N] [--batch N] [--max-failures N]\n"
+                 << "                Update every host in the inventory (defaults: 8 at a\n"
+                 << "                time, one batch, stop after the first failure)\n"
                  << "No options: runs OS detection, gathers system info, and performs update.\n";
             return 0;
+        } else if (arg == "--binlog") {
+            AsyncLogger::instance().enableBinary("update_log");
+        } else if (arg == "--readlog") {
+            string base = "update_log", category;
+            int64_t since = INT64_MIN, until = INT64_MAX;
+            if (i + 1 < argc && argv[i + 1][0] != '-') base = argv[++i];
+            for (++i; i + 1 < argc; i += 2) {
+                string opt = argv[i], val = argv[i + 1];
+                if (opt == "-c") category = val;
+                else if (opt == "--since" || opt == "--until") {
+                    int64_t t = parseTime(val);
+                    if (t < 0) { cerr << "Bad time: " << val << endl; return 1; }
+                    (opt == "--since" ? since : until) = t;
+                } else { cerr << "Unknown option: " << opt << endl; return 1; }
+            }
+            if (i < argc) { cerr << "Missing value for " << argv[i] << endl; return 1; }
+            return readLog(base, category, since, until);
+        } else if (arg == "--delta") {
+            snapshot = "inventory.snap";
+            if (i + 1 < argc && argv[i + 1][0] != '-') snapshot = argv[++i];
+        } else if (arg == "--pkgcheck") {
+#ifdef __linux__
+            if (i + 3 >= argc || !PackageDb::knownOp(argv[i + 2])) {
+                cerr << "Usage: --pkgcheck name <|<=|=|>=|> version" << endl;
+                return 2;
+            }
+            string name = argv[i + 1], op = argv[i + 2], version = argv[i + 3];
+            PackageDb db;
+            if (!db.load()) { cerr << "No package database found" << endl; return 2; }
+            const Package* p = db.find(name);
+            if (!p) { cout << name << " is not installed" << endl; return 1; }
+            bool ok = db.satisfies(name, op, version);
+            cout << name << " " << p->version << (ok ? " satisfies " : " does not satisfy ") << op << " " << version << endl;
+            return ok ? 0 : 1;
+#else
+            cerr << "--pkgcheck is only available on Linux" << endl;
+            return 2;
+#endif
+        } else if (arg == "--fleet") {
+            if (i + 1 >= argc) { cerr << "Missing inventory file" << endl; return 1; }
+            string inventory = argv[++i];
+            size_t parallel = 8, batch = 0, maxFailures = 0;
+            for (++i; i + 1 < argc; i += 2) {
+                string opt = argv[i];
+                size_t val = static_cast<size_t>(atol(argv[i + 1]));
+                if (opt == "--parallel") parallel = val;
+                else if (opt == "--batch") batch = val;
+                else if (opt == "--max-failures") maxFailures = val;
+                else { cerr << "Unknown option: " << opt << endl; return 1; }
+            }
+            if (i < argc) { cerr << "Missing value for " << argv[i] << endl; return 1; }
+            vector<FleetHost> hosts;
+            if (!loadInventory(inventory, hosts)) return 1;
+            return Fleet(move(hosts), parallel, batch, maxFailures).run();
         }
     }
 
     UpdaterManager manager;
     manager.detectOS();        // Detect the OS
-    manager.gatherSystemInfo();// Gather detailed system info
+    manager.gatherSystemInfo(snapshot);// Gather detailed system info
     manager.performUpdate();   // Run update sequence
     return 0;
 };
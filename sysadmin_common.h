@@ -0,0 +1,549 @@
+// Pieces shared by sysadmin_0.0.cpp and sysadmin_1.0.cpp.
+#ifndef SYSADMIN_COMMON_H
+#define SYSADMIN_COMMON_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// strftime layout of log timestamps; a program may define its own before
+// including this header.
+#ifndef LOG_STAMP_FORMAT
+#define LOG_STAMP_FORMAT "%Y-%m-%d %H:%M:%S"
+#endif
+
+// ----------------------
+// Logging
+// ----------------------
+// Asynchronous logger: callers push records into a bounded lock-free ring
+// (Vyukov's MPMC queue, used here with a single consumer) and a background
+// thread formats and writes them. The timestamp string is rebuilt once per
+// second, and a batch goes out in one write once it reaches FLUSH_BYTES, is
+// FLUSH_MS old, or the program exits. A full ring makes callers wait rather
+// than drop records. Records read "[stamp] [category] message" (no category
+// part when it is empty; such records are filed under "main" in the binary
+// log).
+// Binary log (--binlog), kept next to the text log as two files:
+//   <base>.bin  "ULD1" + 4 pad bytes, then message bytes back to back
+//   <base>.idx  "ULI1" + 4 pad bytes, then one BinEntry per record
+// A category is named once per run by an entry with DEF_FLAG set in len whose
+// bytes are the name; ids are FNV-1a hashes of the name, so a reader can
+// filter by category without that table. Index timestamps never decrease,
+// which lets a reader binary-search a time range.
+struct BinEntry {
+    int64_t ts;
+    uint32_t cat;
+    uint32_t len;       // DEF_FLAG | name length for category definitions
+    uint64_t off;       // into <base>.bin
+};
+static_assert(sizeof(BinEntry) == 24, "index entry layout");
+const uint32_t DEF_FLAG = 0x80000000u;
+
+inline uint32_t categoryId(const string& name) {
+    uint32_t h = 2166136261u;
+    for (unsigned char c : name) h = (h ^ c) * 16777619u;
+    return h;
+}
+
+class AsyncLogger {
+public:
+    static constexpr size_t RING = 4096;           // power of two
+    static constexpr size_t FLUSH_BYTES = 64 * 1024;
+    static constexpr int FLUSH_MS = 200;
+
+    static AsyncLogger& instance() {
+        static AsyncLogger logger;
+        return logger;
+    }
+
+    // Sets the log file for every batch not yet written; with none set,
+    // records are dropped.
+    void open(const string& path) {
+        lock_guard<mutex> guard(sinkMutex);
+        if (file) fclose(file);
+        file = nullptr;
+        filePath = path;
+        openFailed = false;
+    }
+
+    void log(const string& category, const string& message) {
+        size_t pos = tail.load(memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &ring[pos & (RING - 1)];
+            size_t seq = cell->seq.load(memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                this_thread::yield();                  // ring full: wait for the writer
+                pos = tail.load(memory_order_relaxed);
+            } else {
+                pos = tail.load(memory_order_relaxed);
+            }
+        }
+        cell->when = time(nullptr);
+        cell->category = category;
+        cell->message = message;
+        cell->seq.store(pos + 1, memory_order_release);
+    }
+
+    // Also write <base>.bin/.idx; call before the first message is logged.
+    void enableBinary(const string& base) {
+        binBase = base;
+        binOn.store(true, memory_order_release);
+    }
+
+    ~AsyncLogger() {
+        stopping.store(true, memory_order_release);
+        if (worker.joinable()) worker.join();
+        if (file) fclose(file);
+        if (binData) fclose(binData);
+        if (binIndex) fclose(binIndex);
+    }
+
+private:
+    struct Cell {
+        atomic<size_t> seq;
+        time_t when;
+        string category, message;
+    };
+
+    vector<Cell> ring;
+    atomic<size_t> tail{0};
+    atomic<bool> stopping{false};
+    size_t head = 0;                                    // consumer only
+    mutex sinkMutex;                                    // guards file/filePath against open()
+    FILE* file = nullptr;                               // opened on the first batch
+    string filePath;
+    bool openFailed = false;
+    atomic<bool> binOn{false};
+    string binBase;
+    FILE* binData = nullptr;
+    FILE* binIndex = nullptr;
+    uint64_t binEnd = 0;                                // size of <base>.bin
+    int64_t lastTs = 0;
+    vector<uint32_t> defined;                           // category ids named this run
+    string binBytes, binEntries;                        // pending binary batch
+    thread worker;
+
+    AsyncLogger() : ring(RING) {
+        for (size_t i = 0; i < RING; ++i) ring[i].seq.store(i, memory_order_relaxed);
+        worker = thread([this] { run(); });
+    }
+
+    void run() {
+        string batch, stamp;
+        time_t stampFor = -1;
+        size_t pending = 0;
+        auto oldest = chrono::steady_clock::now();
+        for (;;) {
+            bool stop = stopping.load(memory_order_acquire);
+            bool got = false;
+            for (;;) {
+                Cell& cell = ring[head & (RING - 1)];
+                if (cell.seq.load(memory_order_acquire) != head + 1) break;
+                if (cell.when != stampFor) {
+                    char buf[64];
+                    strftime(buf, sizeof(buf), LOG_STAMP_FORMAT, localtime(&cell.when));
+                    stamp = buf;
+                    stampFor = cell.when;
+                }
+                if (!pending) oldest = chrono::steady_clock::now();
+                batch += '['; batch += stamp; batch += "] ";
+                if (!cell.category.empty()) { batch += '['; batch += cell.category; batch += "] "; }
+                batch += cell.message; batch += '\n';
+                if (binOn.load(memory_order_acquire)) addBinary(cell.when, cell.category, cell.message);
+                cell.category.clear(); cell.message.clear();
+                cell.seq.store(head + RING, memory_order_release);
+                ++head; ++pending; got = true;
+                if (batch.size() >= FLUSH_BYTES) break;
+            }
+            bool due = pending && (batch.size() >= FLUSH_BYTES || stop
+                        || chrono::steady_clock::now() - oldest >= chrono::milliseconds(FLUSH_MS));
+            if (due) {
+                write_batch(batch);
+                batch.clear();
+                pending = 0;
+            }
+            if (stop && !got && !pending) return;
+            if (!got) this_thread::sleep_for(chrono::milliseconds(pending ? 5 : 20));
+        }
+    }
+
+    void addEntry(int64_t ts, uint32_t cat, uint32_t len, const string& bytes) {
+        BinEntry e{ts, cat, len, binEnd + binBytes.size()};
+        binBytes += bytes;
+        binEntries.append(reinterpret_cast<const char*>(&e), sizeof(e));
+    }
+
+    void addBinary(time_t when, string category, const string& message) {
+        if (category.empty()) category = "main";
+        lastTs = max<int64_t>(lastTs, when);
+        uint32_t id = categoryId(category);
+        if (find(defined.begin(), defined.end(), id) == defined.end()) {
+            defined.push_back(id);
+            addEntry(lastTs, id, DEF_FLAG | static_cast<uint32_t>(category.size()), category);
+        }
+        addEntry(lastTs, id, static_cast<uint32_t>(message.size()), message);
+    }
+
+    static FILE* openBinary(const string& path, const char* magic, uint64_t& size) {
+        FILE* f = fopen(path.c_str(), "ab");
+        if (!f) return nullptr;
+        setvbuf(f, nullptr, _IONBF, 0);
+        fseek(f, 0, SEEK_END);
+        long end = ftell(f);
+        if (end <= 0) { fwrite(magic, 1, 4, f); fwrite("\0\0\0\0", 1, 4, f); end = 8; }
+        size = static_cast<uint64_t>(end);
+        return f;
+    }
+
+    // Message bytes go out before the index entries that point at them.
+    void writeBinary() {
+        if (binEntries.empty()) return;
+        if (!binData) {
+            uint64_t idxSize = 0;
+            binData = openBinary(binBase + ".bin", "ULD1", binEnd);
+            binIndex = binData ? openBinary(binBase + ".idx", "ULI1", idxSize) : nullptr;
+            if (!binIndex) {
+                cerr << "Error opening binary log!" << endl;
+                binOn.store(false, memory_order_relaxed);
+                binBytes.clear(); binEntries.clear();
+                return;
+            }
+            // Entries were queued assuming an empty data file; rebase them.
+            for (size_t i = 0; i < binEntries.size(); i += sizeof(BinEntry)) {
+                BinEntry e;
+                memcpy(&e, binEntries.data() + i, sizeof(e));
+                e.off += binEnd;
+                memcpy(&binEntries[i], &e, sizeof(e));
+            }
+        }
+        fwrite(binBytes.data(), 1, binBytes.size(), binData);
+        fwrite(binEntries.data(), 1, binEntries.size(), binIndex);
+        binEnd += binBytes.size();
+        binBytes.clear(); binEntries.clear();
+    }
+
+    // One unbuffered fwrite per batch, i.e. one write(2) (plus two with --binlog).
+    void write_batch(const string& batch) {
+        lock_guard<mutex> guard(sinkMutex);
+        if (!file && !openFailed && !filePath.empty()) {
+            file = fopen(filePath.c_str(), "ab");
+            if (file) setvbuf(file, nullptr, _IONBF, 0);
+            else { openFailed = true; cerr << "Error opening log file!" << endl; }
+        }
+        if (file) fwrite(batch.data(), 1, batch.size(), file);
+        writeBinary();
+    }
+};
+
+
+// ----------------------
+// Command lookup
+// ----------------------
+#ifndef _WIN32
+// Resolves command names against $PATH in process (access(X_OK) per PATH
+// directory) and remembers the answer for the rest of the run. With
+// UPDATER_CMD_CACHE=<file> the answers are also kept on disk and reused by
+// later runs as long as PATH and every PATH directory's mtime are unchanged
+// (installing or removing a package touches the directory).
+// POSIX only; callers keep their own Windows fallback.
+class CommandCache {
+public:
+    static CommandCache& instance() {
+        static CommandCache cache;
+        return cache;
+    }
+
+    bool exists(const string& cmd) {
+        lock_guard<mutex> guard(m);
+        auto it = known.find(cmd);
+        if (it != known.end()) return it->second;
+        bool found = resolve(cmd);
+        known.emplace(cmd, found);
+        dirty = true;
+        return found;
+    }
+
+    ~CommandCache() {
+        if (!dirty || store.empty()) return;
+        ofstream out(store, ios::trunc);
+        out << "PATH " << path << "\n";
+        for (auto& d : dirs) out << "D " << d.second << " " << d.first << "\n";
+        for (auto& k : known) out << "C " << k.second << " " << k.first << "\n";
+    }
+
+private:
+    mutex m;
+    string path, store;
+    vector<pair<string, long long>> dirs;               // PATH entry, mtime in ns
+    bool dirty = false;
+
+    static long long mtimeNs(const struct stat& st) {
+#ifdef __APPLE__
+        return st.st_mtimespec.tv_sec * 1000000000LL + st.st_mtimespec.tv_nsec;
+#else
+        return st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+#endif
+    }
+    unordered_map<string, bool> known;
+
+    CommandCache() {
+        const char* p = getenv("PATH");
+        path = p ? p : "";
+        stringstream ss(path);
+        string dir;
+        while (getline(ss, dir, ':')) {
+            if (dir.empty()) dir = ".";
+            struct stat st;
+            dirs.emplace_back(dir, stat(dir.c_str(), &st) == 0 ? mtimeNs(st) : -1);
+        }
+        if (const char* s = getenv("UPDATER_CMD_CACHE")) store = s;
+        if (!store.empty()) load();
+    }
+
+    void load() {
+        ifstream in(store);
+        string line;
+        if (!getline(in, line) || line != "PATH " + path) return;
+        size_t d = 0;
+        unordered_map<string, bool> saved;
+        while (getline(in, line)) {
+            istringstream ls(line);
+            string kind, rest;
+            long long value;
+            if (!(ls >> kind >> value) || !getline(ls >> ws, rest)) return;
+            if (kind == "D") {
+                if (d >= dirs.size() || dirs[d].first != rest || dirs[d].second != value) return;   // PATH changed
+                ++d;
+            } else if (kind == "C") saved.emplace(rest, value != 0);
+        }
+        if (d == dirs.size()) known.swap(saved);
+    }
+
+    bool resolve(const string& cmd) const {
+        if (cmd.find('/') != string::npos) return access(cmd.c_str(), X_OK) == 0;
+        for (auto& d : dirs) {
+            string full = d.first + "/" + cmd;
+            struct stat st;
+            if (access(full.c_str(), X_OK) == 0 && stat(full.c_str(), &st) == 0 && S_ISREG(st.st_mode)) return true;
+        }
+        return false;
+    }
+};
+
+#endif
+
+// ----------------------
+// Inventory snapshots
+// ----------------------
+// The last inventory is kept as content hashes only, so a run can print just
+// the sections that changed. File layout:
+//   "UIS1", u32 count, then per section: u64 FNV-1a hash, u32 name length, name
+// A missing or unreadable snapshot makes every section count as changed.
+using InventorySection = pair<string, string>;   // name, text
+
+inline uint64_t contentHash(const string& text) {
+    uint64_t h = 14695981039346656037ull;
+    for (unsigned char c : text) h = (h ^ c) * 1099511628211ull;
+    return h;
+}
+
+class InventorySnapshot {
+public:
+    explicit InventorySnapshot(string path) : path(move(path)) {
+        ifstream in(this->path, ios::binary);
+        char magic[4];
+        uint32_t count = 0;
+        if (!in.read(magic, 4) || memcmp(magic, "UIS1", 4) != 0 || !in.read(reinterpret_cast<char*>(&count), 4)) return;
+        for (uint32_t i = 0; i < count; ++i) {
+            uint64_t hash;
+            uint32_t len;
+            if (!in.read(reinterpret_cast<char*>(&hash), 8) || !in.read(reinterpret_cast<char*>(&len), 4) || len > 4096) {
+                last.clear();
+                return;
+            }
+            string name(len, '\0');
+            if (!in.read(&name[0], len)) { last.clear(); return; }
+            last[name] = hash;
+        }
+    }
+
+    // Sections that are new or differ from the snapshot; names of sections
+    // the snapshot had but `sections` does not go to `removed`.
+    vector<InventorySection> changed(const vector<InventorySection>& sections, vector<string>& removed) const {
+        vector<InventorySection> out;
+        for (auto& s : sections) {
+            auto it = last.find(s.first);
+            if (it == last.end() || it->second != contentHash(s.second)) out.push_back(s);
+        }
+        set<string> names;
+        for (auto& s : sections) names.insert(s.first);
+        for (auto& l : last)
+            if (!names.count(l.first)) removed.push_back(l.first);
+        return out;
+    }
+
+    bool contains(const string& name) const { return last.count(name) != 0; }
+
+    // Replaces the snapshot with `sections` (written aside, then renamed).
+    bool save(const vector<InventorySection>& sections) {
+        string tmp = path + ".tmp";
+        {
+            ofstream out(tmp, ios::binary | ios::trunc);
+            uint32_t count = static_cast<uint32_t>(sections.size());
+            out.write("UIS1", 4);
+            out.write(reinterpret_cast<const char*>(&count), 4);
+            for (auto& s : sections) {
+                uint64_t hash = contentHash(s.second);
+                uint32_t len = static_cast<uint32_t>(s.first.size());
+                out.write(reinterpret_cast<const char*>(&hash), 8);
+                out.write(reinterpret_cast<const char*>(&len), 4);
+                out.write(s.first.data(), len);
+            }
+            if (!out) return false;
+        }
+        if (rename(tmp.c_str(), path.c_str()) != 0) return false;
+        last.clear();
+        for (auto& s : sections) last[s.first] = contentHash(s.second);
+        return true;
+    }
+
+private:
+    string path;
+    map<string, uint64_t> last;
+};
+
+// ----------------------
+// Binary log reader
+// ----------------------
+// Read-only map of a whole file (read into memory where mmap is missing).
+class MappedFile {
+public:
+    explicit MappedFile(const string& path) {
+#ifdef _WIN32
+        ifstream in(path, ios::binary);
+        if (!in) return;
+        copy.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+        ptr = copy.data(); len = copy.size(); ok = true;
+#else
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* m = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (m != MAP_FAILED) { ptr = static_cast<const char*>(m); len = static_cast<size_t>(st.st_size); ok = true; }
+        }
+        close(fd);
+#endif
+    }
+    ~MappedFile() {
+#ifndef _WIN32
+        if (ptr) munmap(const_cast<char*>(ptr), len);
+#endif
+    }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    const char* ptr = nullptr;
+    size_t len = 0;
+    bool ok = false;
+private:
+#ifdef _WIN32
+    string copy;
+#endif
+};
+
+// Epoch seconds, "YYYY-MM-DD" or "YYYY-MM-DD HH:MM:SS" (local time); -1 if invalid.
+inline int64_t parseTime(const string& s) {
+    if (!s.empty() && all_of(s.begin(), s.end(), [](char c) { return c >= '0' && c <= '9'; })) return stoll(s);
+    tm t{};
+    istringstream in(s);
+    in >> get_time(&t, s.size() > 10 ? "%Y-%m-%d %H:%M:%S" : "%Y-%m-%d");
+    if (in.fail()) return -1;
+    t.tm_isdst = -1;
+    return static_cast<int64_t>(mktime(&t));
+}
+
+// Prints records of <base>.idx/.bin in [since, until], optionally only one
+// category. The time range is found by binary search on the index; message
+// bytes are only touched for records that are printed.
+inline int readLog(const string& base, const string& category, int64_t since, int64_t until) {
+    MappedFile idx(base + ".idx"), dat(base + ".bin");
+    if (!idx.ok || !dat.ok || idx.len < 8 || dat.len < 8 || memcmp(idx.ptr, "ULI1", 4) != 0 || memcmp(dat.ptr, "ULD1", 4) != 0) {
+        cerr << "No binary log at " << base << ".idx/.bin" << endl;
+        return 1;
+    }
+    const BinEntry* first = reinterpret_cast<const BinEntry*>(idx.ptr + 8);
+    const BinEntry* last = first + (idx.len - 8) / sizeof(BinEntry);
+    const BinEntry* it = lower_bound(first, last, since, [](const BinEntry& e, int64_t t) { return e.ts < t; });
+    const bool filter = !category.empty();
+    const uint32_t want = categoryId(category);
+
+    map<uint32_t, string> names;
+    bool allNames = false;
+    auto nameOf = [&](uint32_t id) -> const string& {
+        auto f = names.find(id);
+        if (f == names.end() && !allNames) {        // defined before the range: one pass over the index
+            for (const BinEntry* d = first; d != last; ++d)
+                if ((d->len & DEF_FLAG) && d->off + (d->len & ~DEF_FLAG) <= dat.len)
+                    names.emplace(d->cat, string(dat.ptr + d->off, d->len & ~DEF_FLAG));
+            allNames = true;
+            f = names.find(id);
+        }
+        if (f == names.end()) f = names.emplace(id, "?").first;
+        return f->second;
+    };
+
+    string out, stamp;
+    int64_t stampFor = -1;
+    size_t shown = 0;
+    for (; it != last && it->ts <= until; ++it) {
+        uint32_t n = it->len & ~DEF_FLAG;
+        if (it->off + n > dat.len) break;           // index written ahead of a torn data file
+        if (it->len & DEF_FLAG) { names.emplace(it->cat, string(dat.ptr + it->off, n)); continue; }
+        if (filter && it->cat != want) continue;
+        if (it->ts != stampFor) {
+            time_t t = static_cast<time_t>(it->ts);
+            char buf[64];
+            strftime(buf, sizeof(buf), LOG_STAMP_FORMAT, localtime(&t));
+            stamp = buf;
+            stampFor = it->ts;
+        }
+        out += '['; out += stamp; out += "] [";
+        out += filter ? category : nameOf(it->cat); out += "] ";
+        out.append(dat.ptr + it->off, n); out += '\n';
+        ++shown;
+        if (out.size() >= 1 << 16) { fwrite(out.data(), 1, out.size(), stdout); out.clear(); }
+    }
+    fwrite(out.data(), 1, out.size(), stdout);
+    cerr << shown << " records" << endl;
+    return 0;
+}
+
+#endif